@@ -132,18 +132,22 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadAssetsAndCreateEntities()
 {
+	// Should the meshes use the compact PackedVertex format?  Their
+	// vertex shaders need to match, so this swaps those, too
+	const bool packVertices = true;
+
 	// Load shaders using our succinct LoadShader() macro
-	std::shared_ptr<SimpleVertexShader> vertexShader	= LoadShader(SimpleVertexShader, L"VertexShader.cso");
+	std::shared_ptr<SimpleVertexShader> vertexShader	= packVertices ? LoadPackedVertexShader(L"VertexShaderPacked.cso") : LoadShader(SimpleVertexShader, L"VertexShader.cso");
 	std::shared_ptr<SimplePixelShader> pixelShader		= LoadShader(SimplePixelShader, L"PixelShader.cso");
 	std::shared_ptr<SimplePixelShader> pixelShaderPBR	= LoadShader(SimplePixelShader, L"PixelShaderPBR.cso");
 	std::shared_ptr<SimplePixelShader> solidColorPS		= LoadShader(SimplePixelShader, L"SolidColorPS.cso");
 
-	std::shared_ptr<SimpleVertexShader> skyVS = LoadShader(SimpleVertexShader, L"SkyVS.cso");
+	std::shared_ptr<SimpleVertexShader> skyVS = packVertices ? LoadPackedVertexShader(L"SkyVSPacked.cso") : LoadShader(SimpleVertexShader, L"SkyVS.cso");
 	std::shared_ptr<SimplePixelShader> skyPS  = LoadShader(SimplePixelShader, L"SkyPS.cso");
 
 	// Make the meshes
-	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/sphere.obj").c_str(), device);
-	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cube.obj").c_str(), device);
+	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/sphere.obj").c_str(), device, packVertices);
+	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cube.obj").c_str(), device, packVertices);
 
 	// Declare the textures we'll need
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleA,  cobbleN,  cobbleR,  cobbleM;
@@ -633,6 +637,30 @@ void Game::LoadAssetsAndCreateEntities()
 }
 
 
+// --------------------------------------------------------
+// Loads a vertex shader for meshes made of PackedVertex,
+// which needs an input layout describing those formats
+// rather than the all-float one SimpleShader would guess
+// --------------------------------------------------------
+std::shared_ptr<SimpleVertexShader> Game::LoadPackedVertexShader(const std::wstring& file)
+{
+	// The layout is checked against the shader's actual inputs
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	if (SUCCEEDED(D3DReadFileToBlob(FixPath(file).c_str(), shaderBlob.GetAddressOf())))
+	{
+		device->CreateInputLayout(
+			PackedVertexLayout,
+			ARRAYSIZE(PackedVertexLayout),
+			shaderBlob->GetBufferPointer(),
+			shaderBlob->GetBufferSize(),
+			inputLayout.GetAddressOf());
+	}
+
+	return std::make_shared<SimpleVertexShader>(device.Get(), context.Get(), FixPath(file).c_str(), inputLayout, false);
+}
+
+
 // --------------------------------------------------------
 // Generates the lights in the scene: 3 directional lights
 // and many random point lights.
@@ -814,6 +842,11 @@ void Game::DrawPointLights()
 	// Set up vertex shader
 	lightVS->SetMatrix4x4("view", camera->GetView());
 	lightVS->SetMatrix4x4("projection", camera->GetProjection());
+	if (lightMesh->IsPacked())
+	{
+		lightVS->SetFloat3("boundsMin", lightMesh->GetBoundsMin());
+		lightVS->SetFloat3("boundsMax", lightMesh->GetBoundsMax());
+	}
 
 	for (int i = 0; i < lightCount; i++)
 	{
@@ -1091,6 +1124,8 @@ void Game::EntityUI(std::shared_ptr<GameEntity> entity)
 	// Mesh details
 	ImGui::Spacing();
 	ImGui::Text("Mesh Index Count: %d", entity->GetMesh()->GetIndexCount());
+	ImGui::Text("Mesh Vertex Count: %d", entity->GetMesh()->GetVertexCount());
+	ImGui::Text("Mesh Vertex Size: %d bytes", entity->GetMesh()->GetVertexStride());
 
 	ImGui::Spacing();
 }
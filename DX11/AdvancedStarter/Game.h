@@ -60,6 +60,7 @@ private:
 
 	// General helpers for setup and drawing
 	void LoadAssetsAndCreateEntities();
+	std::shared_ptr<SimpleVertexShader> LoadPackedVertexShader(const std::wstring& file);
 	void GenerateLights();
 	void DrawPointLights();
 
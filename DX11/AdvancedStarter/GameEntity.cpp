@@ -18,6 +18,14 @@ void GameEntity::SetMaterial(std::shared_ptr<Material> material) { this->materia
 
 void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
 {
+	// Packed meshes store positions relative to their bounds,
+	// which the vertex shader needs in order to decode them
+	if (mesh->IsPacked())
+	{
+		material->GetVertexShader()->SetFloat3("boundsMin", mesh->GetBoundsMin());
+		material->GetVertexShader()->SetFloat3("boundsMax", mesh->GetBoundsMax());
+	}
+
 	// Set up the material (shaders)
 	material->PrepareMaterial(&transform, camera);
 
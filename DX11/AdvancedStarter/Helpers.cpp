@@ -1,4 +1,7 @@
 
+// codecvt is deprecated as of C++17, but still the simplest portable conversion
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+
 #include <Windows.h>
 #include <codecvt>
 #include <locale>
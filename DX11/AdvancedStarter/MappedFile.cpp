@@ -0,0 +1,53 @@
+#include "MappedFile.h"
+
+
+// --------------------------------------------------------
+// Opens and maps the given file.  Check IsOpen() to see
+// if it worked - empty files can't be mapped, so they
+// count as failures too.
+// 
+// path - Path to the file to map
+// --------------------------------------------------------
+MappedFile::MappedFile(const std::wstring& path) :
+	file(INVALID_HANDLE_VALUE),
+	mapping(0),
+	data(0),
+	size(0)
+{
+	// Open the file itself, hinting that we'll read it front to back
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	// Map the whole thing
+	mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (mapping == 0)
+		return;
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data != 0)
+		size = (size_t)fileSize.QuadPart;
+}
+
+
+// --------------------------------------------------------
+// Unmaps the view and closes the handles
+// --------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	if (data != 0) UnmapViewOfFile(data);
+	if (mapping != 0) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+
+// --------------------------------------------------------
+// Getters for the mapped bytes
+// --------------------------------------------------------
+bool MappedFile::IsOpen() { return data != 0; }
+const char* MappedFile::GetData() { return data; }
+size_t MappedFile::GetSize() { return size; }
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Windows.h>
+#include <string>
+
+// --------------------------------------------------------
+// A read-only view of a whole file, mapped into memory so
+// it can be read directly without copying it into buffers
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const std::wstring& path);
+	~MappedFile();
+
+	// Mappings own OS handles, so they can't be copied
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const char* data;
+	size_t size;
+};
+
@@ -1,9 +1,16 @@
 #include "Mesh.h"
+#include "ObjLoader.h"
+#include "MeshCache.h"
+#include "../../MeshOptimizer/MeshOptimizer.h"
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <vector>
-#include <fstream>
 
 using namespace DirectX;
+using namespace DirectX::PackedVector;
 
 // --------------------------------------------------------
 // Creates a new mesh with the given geometry
@@ -13,10 +20,17 @@ using namespace DirectX;
 // indexArray - An array of indices into the vertex array
 // numIndices - The number of indices in the index array
 // device     - The D3D device to use for buffer creation
+// packVertices - Store the vertices as PackedVertex instead?
 // --------------------------------------------------------
-Mesh::Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device) :
-	numIndices(0)
+Mesh::Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, bool packVertices) :
+	numIndices(0),
+	numVertices(0),
+	packed(packVertices),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0)
 {
+	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	CalculateBounds(vertArray, numVerts);
 	CreateBuffers(vertArray, numVerts, indexArray, numIndices, device);
 }
 
@@ -24,172 +38,68 @@ Mesh::Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t
 // --------------------------------------------------------
 // Creates a new mesh by loading vertices from the given .obj file
 // 
+// - The triangles and vertices are reordered for the GPU's
+//    vertex cache, overdraw and vertex fetching
+// - The finished mesh is saved to a binary cache file the
+//    first time, and later loads just map that file and
+//    hand it straight to D3D, skipping the parsing,
+//    optimization and tangent calculation entirely
+// 
+// - The cache always holds full Vertex data, so packing
+//    is just a quick pass over it while creating buffers
+// 
 // objFile  - Path to the .obj 3D model file to load
 // device   - The D3D device to use for buffer creation
+// packVertices - Store the vertices as PackedVertex instead?
 // --------------------------------------------------------
-Mesh::Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device) :
-	numIndices(0)
+Mesh::Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, bool packVertices) :
+	numIndices(0),
+	numVertices(0),
+	packed(packVertices),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0)
 {
-	// File input object
-	std::ifstream obj(objFile);
-
-	// Check for successful open
-	if (!obj.is_open())
+	// Find the cache file for this exact version of the model
+	auto startTime = std::chrono::high_resolution_clock::now();
+	unsigned long long sourceHash = 0;
+	std::wstring cacheFile = GetMeshCachePath(objFile, sourceHash);
+	if (cacheFile.empty())
+	{
+		printf("Could not open model file %ls\n", objFile.c_str());
 		return;
+	}
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	// Already built?  Then the data is ready to use as-is
+	MeshCacheView cache;
+	if (LoadMeshCache(cacheFile, sourceHash, cache))
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		boundsMin = cache.Header->BoundsMin;
+		boundsMax = cache.Header->BoundsMax;
+		CreateBuffers(cache.Vertices, cache.Header->VertexCount, cache.Indices, cache.Header->IndexCount, device);
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm = { 0, 0, 0 };
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv = { 0, 0 };
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos = { 0, 0, 0 };
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			//  If the model is missing any of these, this 
-			//  code will not handle the file correctly!
-			unsigned int i[12] = {};
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1 = {};
-			v1.Position = positions[max(i[0] - 1, 0)];
-			v1.UV = uvs[max(i[1] - 1, 0)];
-			v1.Normal = normals[max(i[2] - 1, 0)];
-
-			Vertex v2 = {};
-			v2.Position = positions[max(i[3] - 1, 0)];
-			v2.UV = uvs[max(i[4] - 1, 0)];
-			v2.Normal = normals[max(i[5] - 1, 0)];
-
-			Vertex v3 = {};
-			v3.Position = positions[max(i[6] - 1, 0)];
-			v3.UV = uvs[max(i[7] - 1, 0)];
-			v3.Normal = normals[max(i[8] - 1, 0)];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
-			{
-				// Make the last vertex
-				Vertex v4 = {};
-				v4.Position = positions[max(i[9] - 1, 0)];
-				v4.UV = uvs[max(i[10] - 1, 0)];
-				v4.Normal = normals[max(i[11] - 1, 0)];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-			}
-		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		printf("Loaded %ls from its cache: %u vertices, %.1f ms\n", objFile.c_str(), numVertices, ms);
+		return;
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
-	CreateBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
+	// Read the file's triangles, with vertices already shared between faces
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!LoadObj(objFile, verts, indices) || indices.empty())
+		return;
+
+	// Reorder it all for the GPU's caches
+	VertexCacheStats before, after;
+	verts.resize(OptimizeMesh(&verts[0], verts.size(), sizeof(Vertex), &indices[0], indices.size(), before, after));
+	printf("  Optimized: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+
+	// Finish the data and save it for next time
+	CalculateTangents(&verts[0], verts.size(), &indices[0], indices.size());
+	CalculateBounds(&verts[0], verts.size());
+	if (!SaveMeshCache(cacheFile, sourceHash, &verts[0], verts.size(), &indices[0], indices.size(), boundsMin, boundsMax))
+		printf("Could not write mesh cache file %ls\n", cacheFile.c_str());
+
+	CreateBuffers(&verts[0], verts.size(), &indices[0], indices.size(), device);
 }
 
 
@@ -207,11 +117,18 @@ Mesh::~Mesh() { }
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer() { return vb; }
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer() { return ib; }
 unsigned int Mesh::GetIndexCount() { return numIndices; }
+unsigned int Mesh::GetVertexCount() { return numVertices; }
+unsigned int Mesh::GetVertexStride() { return packed ? sizeof(PackedVertex) : sizeof(Vertex); }
+bool Mesh::IsPacked() { return packed; }
+XMFLOAT3 Mesh::GetBoundsMin() { return boundsMin; }
+XMFLOAT3 Mesh::GetBoundsMax() { return boundsMax; }
 
 
 // --------------------------------------------------------
 // Helper for creating the actual D3D buffers.
-// Also calculates tangents for each vertex before creating buffers.
+// Tangents must already be calculated, as the data is
+// uploaded exactly as given (or packed, along with the
+// bounds, if this mesh uses PackedVertex).
 // 
 // vertArray  - An array of vertices
 // numVerts   - The number of verts in the array
@@ -219,21 +136,23 @@ unsigned int Mesh::GetIndexCount() { return numIndices; }
 // numIndices - The number of indices in the index array
 // device     - The D3D device to use for buffer creation
 // --------------------------------------------------------
-void Mesh::CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
+void Mesh::CreateBuffers(const Vertex* vertArray, size_t numVerts, const unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
-	// Calculate the tangents of each vertex first
-	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	// Compress the vertices first if necessary
+	std::vector<PackedVertex> packedVerts;
+	if (packed)
+		PackVertices(vertArray, numVerts, packedVerts);
 
 	// Create the vertex buffer
 	D3D11_BUFFER_DESC vbd = {};
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * (UINT)numVerts; // Number of vertices
+	vbd.ByteWidth = GetVertexStride() * (UINT)numVerts; // Number of vertices
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
 	vbd.StructureByteStride = 0;
 	D3D11_SUBRESOURCE_DATA initialVertexData = {};
-	initialVertexData.pSysMem = vertArray;
+	initialVertexData.pSysMem = packed ? (const void*)packedVerts.data() : (const void*)vertArray;
 	device->CreateBuffer(&vbd, &initialVertexData, vb.GetAddressOf());
 
 	// Create the index buffer
@@ -248,8 +167,9 @@ void Mesh::CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* index
 	initialIndexData.pSysMem = indexArray;
 	device->CreateBuffer(&ibd, &initialIndexData, ib.GetAddressOf());
 
-	// Save the indices
+	// Save the counts
 	this->numIndices = (unsigned int)numIndices;
+	this->numVertices = (unsigned int)numVerts;
 }
 
 // --------------------------------------------------------
@@ -298,8 +218,15 @@ void Mesh::CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indic
 		float s2 = v3->UV.x - v1->UV.x;
 		float t2 = v3->UV.y - v1->UV.y;
 
+		// Skip triangles whose UVs don't span an area (or are missing),
+		// as they give no tangent direction and the division would
+		// spread NaNs through every vertex they share
+		float uvArea = s1 * t2 - s2 * t1;
+		if (!(fabsf(uvArea) > 1e-12f))
+			continue;
+
 		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
+		float r = 1.0f / uvArea;
 
 		float tx = (t2 * x1 - t1 * x2) * r;
 		float ty = (t2 * y1 - t1 * y2) * r;
@@ -328,11 +255,128 @@ void Mesh::CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indic
 
 		// Use Gram-Schmidt orthonormalize to ensure
 		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
+		tangent = tangent - normal * XMVector3Dot(normal, tangent);
+
+		// Vertices without usable UVs (like every vertex of a model
+		// with no texture coordinates) have no tangent direction, so
+		// give them any one along the surface instead of zero
+		if (!(XMVectorGetX(XMVector3LengthSq(tangent)) > 1e-12f))
+		{
+			XMVECTOR axis = fabsf(verts[i].Normal.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+			tangent = XMVector3Cross(axis, normal);
+		}
 
 		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
+		XMStoreFloat3(&verts[i].Tangent, XMVector3Normalize(tangent));
+	}
+}
+
+
+// --------------------------------------------------------
+// Finds the box around all of the given vertex positions
+// --------------------------------------------------------
+void Mesh::CalculateBounds(const Vertex* verts, size_t numVerts)
+{
+	if (numVerts == 0)
+		return;
+
+	boundsMin = verts[0].Position;
+	boundsMax = verts[0].Position;
+	for (size_t i = 1; i < numVerts; i++)
+	{
+		const XMFLOAT3& p = verts[i].Position;
+		boundsMin = XMFLOAT3(p.x < boundsMin.x ? p.x : boundsMin.x, p.y < boundsMin.y ? p.y : boundsMin.y, p.z < boundsMin.z ? p.z : boundsMin.z);
+		boundsMax = XMFLOAT3(p.x > boundsMax.x ? p.x : boundsMax.x, p.y > boundsMax.y ? p.y : boundsMax.y, p.z > boundsMax.z ? p.z : boundsMax.z);
+	}
+}
+
+
+// --------------------------------------------------------
+// Octahedral encoding (https://jcgt.org/published/0003/02/01/)
+// of a direction as two signed bytes.  Each way of rounding
+// the result is tried, keeping whichever decodes closest.
+// --------------------------------------------------------
+static XMVECTOR DecodeOctahedral(float x, float y)
+{
+	// Must match DecodeOctahedral() in PackedVertex.hlsli
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = z < 0 ? -z : 0;
+	x += x >= 0 ? -t : t;
+	y += y >= 0 ? -t : t;
+	return XMVector3Normalize(XMVectorSet(x, y, z, 0));
+}
+
+static void EncodeOctahedral(const XMFLOAT3& dir, int8_t& outX, int8_t& outY)
+{
+	outX = 0;
+	outY = 0;
+	float length = fabsf(dir.x) + fabsf(dir.y) + fabsf(dir.z);
+
+	// Zero, NaN and infinite directions have nothing to encode,
+	// and casting the NaN they'd round to below is undefined
+	if (length == 0 || !std::isfinite(length))
+		return;
+
+	// Project onto the octahedron, folding the lower half out
+	// over the corners so the whole thing lies flat in a square
+	float x = dir.x / length;
+	float y = dir.y / length;
+	if (dir.z < 0)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	XMVECTOR target = XMVector3Normalize(XMLoadFloat3(&dir));
+	float bestDot = -2.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		float qx = (i & 1) ? ceilf(x * 127.0f) : floorf(x * 127.0f);
+		float qy = (i & 2) ? ceilf(y * 127.0f) : floorf(y * 127.0f);
+		float dot = XMVectorGetX(XMVector3Dot(target, DecodeOctahedral(qx / 127.0f, qy / 127.0f)));
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			outX = (int8_t)qx;
+			outY = (int8_t)qy;
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Converts vertices to the compact PackedVertex format.
+// Bounds must already be calculated, since positions are
+// stored as 16-bit fractions of the way across them.
+// --------------------------------------------------------
+void Mesh::PackVertices(const Vertex* verts, size_t numVerts, std::vector<PackedVertex>& packedVerts)
+{
+	// Position scale for each axis, leaving flat ones at zero
+	float sizeX = boundsMax.x - boundsMin.x;
+	float sizeY = boundsMax.y - boundsMin.y;
+	float sizeZ = boundsMax.z - boundsMin.z;
+	float scaleX = sizeX > 0 ? 65535.0f / sizeX : 0;
+	float scaleY = sizeY > 0 ? 65535.0f / sizeY : 0;
+	float scaleZ = sizeZ > 0 ? 65535.0f / sizeZ : 0;
+
+	packedVerts.resize(numVerts);
+	for (size_t i = 0; i < numVerts; i++)
+	{
+		const Vertex& v = verts[i];
+		PackedVertex& p = packedVerts[i];
+
+		p.Position.x = (uint16_t)((v.Position.x - boundsMin.x) * scaleX + 0.5f);
+		p.Position.y = (uint16_t)((v.Position.y - boundsMin.y) * scaleY + 0.5f);
+		p.Position.z = (uint16_t)((v.Position.z - boundsMin.z) * scaleZ + 0.5f);
+		p.Position.w = 0;
+
+		p.UV.x = XMConvertFloatToHalf(v.UV.x);
+		p.UV.y = XMConvertFloatToHalf(v.UV.y);
+
+		EncodeOctahedral(v.Normal, p.NormalTangent.x, p.NormalTangent.y);
+		EncodeOctahedral(v.Tangent, p.NormalTangent.z, p.NormalTangent.w);
 	}
 }
 
@@ -346,7 +390,7 @@ void Mesh::CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indic
 void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
 	// Set buffers in the input assembler
-	UINT stride = sizeof(Vertex);
+	UINT stride = GetVertexStride();
 	UINT offset = 0;
 	context->IASetVertexBuffers(0, 1, vb.GetAddressOf(), &stride, &offset);
 	context->IASetIndexBuffer(ib.Get(), DXGI_FORMAT_R32_UINT, 0);
@@ -3,6 +3,7 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <string>
+#include <vector>
 
 #include "Vertex.h"
 
@@ -10,14 +11,19 @@
 class Mesh
 {
 public:
-	Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
-	Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, bool packVertices = false);
+	Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, bool packVertices = false);
 	~Mesh();
 
 	// Getters for mesh data
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	unsigned int GetIndexCount();
+	unsigned int GetVertexCount();
+	unsigned int GetVertexStride();
+	bool IsPacked();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
 
 	// Basic mesh drawing
 	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
@@ -27,11 +33,21 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vb;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ib;
 
-	// Total indices in this mesh
+	// Total indices and vertices in this mesh
 	unsigned int numIndices;
+	unsigned int numVertices;
+
+	// Is the vertex buffer made of PackedVertex instead of Vertex?
+	bool packed;
+
+	// Box around every vertex position
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
 
 	// Helper for creating buffers (in the event we add more constructor overloads)
-	void CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	void CreateBuffers(const Vertex* vertArray, size_t numVerts, const unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	void CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indices, size_t numIndices);
+	void CalculateBounds(const Vertex* verts, size_t numVerts);
+	void PackVertices(const Vertex* verts, size_t numVerts, std::vector<PackedVertex>& packedVerts);
 };
 
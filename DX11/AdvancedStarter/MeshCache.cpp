@@ -0,0 +1,148 @@
+#include "MeshCache.h"
+#include "Helpers.h"
+
+#include <cstring>
+#include <cwchar>
+
+using namespace DirectX;
+
+
+// --------------------------------------------------------
+// Hashes a block of memory 8 bytes at a time.  Only used to
+// tell whether a model file changed, so it just needs to be
+// fast and spread its bits well.
+// --------------------------------------------------------
+static unsigned long long HashBytes(const char* data, size_t size)
+{
+	unsigned long long h = 0x9e3779b97f4a7c15ull ^ size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		memcpy(&word, data + i, 8);
+		h = (h ^ word) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	}
+
+	// Any bytes left over, then a final mix
+	unsigned long long word = 0;
+	memcpy(&word, data + i, size - i);
+	h = (h ^ word) * 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+
+// --------------------------------------------------------
+// Hashes the given model file and works out where its cache
+// file lives: a MeshCache folder next to the executable,
+// with the hash in the name so an edited model never finds
+// a stale cache.  Returns an empty string if the model
+// can't be read.
+//
+// sourceFile - Path to the model file
+// sourceHash - Receives the hash of the model file
+// --------------------------------------------------------
+std::wstring GetMeshCachePath(const std::wstring& sourceFile, unsigned long long& sourceHash)
+{
+	MappedFile source(sourceFile);
+	if (!source.IsOpen())
+		return L"";
+	sourceHash = HashBytes(source.GetData(), source.GetSize());
+
+	// Keep the model's name to make the folder easier to browse
+	size_t lastSlash = sourceFile.find_last_of(L"\\/");
+	std::wstring name = lastSlash == std::wstring::npos ? sourceFile : sourceFile.substr(lastSlash + 1);
+
+	wchar_t hash[17] = {};
+	swprintf(hash, 17, L"%016llx", sourceHash);
+	return GetExePath() + L"\\MeshCache\\" + name + L"." + hash + L".mesh";
+}
+
+
+// --------------------------------------------------------
+// Maps a cache file and checks that it was written from the
+// expected source, by this version of the code.  Nothing is
+// copied or converted - the view points into the mapping.
+//
+// cacheFile  - Path from GetMeshCachePath()
+// sourceHash - Hash of the model file it should match
+// view       - Receives the mapped file and its contents
+// --------------------------------------------------------
+bool LoadMeshCache(const std::wstring& cacheFile, unsigned long long sourceHash, MeshCacheView& view)
+{
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>(cacheFile);
+	if (!file->IsOpen() || file->GetSize() < sizeof(MeshCacheHeader))
+		return false;
+
+	const MeshCacheHeader* header = (const MeshCacheHeader*)file->GetData();
+	size_t expectedSize =
+		sizeof(MeshCacheHeader) +
+		sizeof(Vertex) * (size_t)header->VertexCount +
+		sizeof(unsigned int) * (size_t)header->IndexCount;
+	if (memcmp(header->Magic, "MESH", 4) != 0 ||
+		header->Version != MeshCacheVersion ||
+		header->SourceHash != sourceHash ||
+		header->VertexSize != sizeof(Vertex) ||
+		file->GetSize() != expectedSize)
+		return false;
+
+	view.Header = header;
+	view.Vertices = (const Vertex*)(file->GetData() + sizeof(MeshCacheHeader));
+	view.Indices = (const unsigned int*)(view.Vertices + header->VertexCount);
+	view.File = std::move(file);
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Writes finished mesh data to a cache file.  It's written
+// under a temporary name first and then renamed, so a run
+// that stops part way never leaves a broken cache behind.
+//
+// cacheFile  - Path from GetMeshCachePath()
+// sourceHash - Hash of the model file the data came from
+// verts, etc - The final vertices (with tangents) and indices
+// boundsMin  - Corners of the box around every position
+// boundsMax
+// --------------------------------------------------------
+bool SaveMeshCache(const std::wstring& cacheFile, unsigned long long sourceHash,
+	const Vertex* verts, size_t numVerts, const unsigned int* indices, size_t numIndices,
+	XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	// Make the folder, which is fine to fail if it's already there
+	size_t lastSlash = cacheFile.find_last_of(L"\\/");
+	if (lastSlash != std::wstring::npos)
+		CreateDirectoryW(cacheFile.substr(0, lastSlash).c_str(), 0);
+
+	MeshCacheHeader header = {};
+	memcpy(header.Magic, "MESH", 4);
+	header.Version = MeshCacheVersion;
+	header.SourceHash = sourceHash;
+	header.VertexSize = sizeof(Vertex);
+	header.VertexCount = (unsigned int)numVerts;
+	header.IndexCount = (unsigned int)numIndices;
+	header.BoundsMin = boundsMin;
+	header.BoundsMax = boundsMax;
+
+	std::wstring tempFile = cacheFile + L".tmp";
+	HANDLE file = CreateFileW(tempFile.c_str(), GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	bool success =
+		WriteFile(file, &header, sizeof(header), &written, 0) &&
+		WriteFile(file, verts, (DWORD)(sizeof(Vertex) * numVerts), &written, 0) &&
+		WriteFile(file, indices, (DWORD)(sizeof(unsigned int) * numIndices), &written, 0);
+	CloseHandle(file);
+
+	if (!success || !MoveFileExW(tempFile.c_str(), cacheFile.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileW(tempFile.c_str());
+		return false;
+	}
+	return true;
+}
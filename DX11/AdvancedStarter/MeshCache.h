@@ -0,0 +1,49 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <memory>
+#include <string>
+
+#include "MappedFile.h"
+#include "Vertex.h"
+
+// Change this whenever the file layout or the steps that
+// build a mesh change, so old cache files are rebuilt
+const unsigned int MeshCacheVersion = 2;
+
+// --------------------------------------------------------
+// The start of a mesh cache file, followed directly by
+// the vertices and then the indices
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char Magic[4];                    // "MESH"
+	unsigned int Version;             // MeshCacheVersion when written
+	unsigned long long SourceHash;    // Hash of the model file this was built from
+	unsigned int VertexSize;          // sizeof(Vertex) when written
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	unsigned int Padding;
+	DirectX::XMFLOAT3 BoundsMin;      // Corners of the box around every position
+	DirectX::XMFLOAT3 BoundsMax;
+};
+
+// --------------------------------------------------------
+// A mesh cache file mapped into memory.  The pointers lead
+// straight into the mapping, so they're only good for as
+// long as this is around.
+// --------------------------------------------------------
+struct MeshCacheView
+{
+	std::unique_ptr<MappedFile> File;
+	const MeshCacheHeader* Header = 0;
+	const Vertex* Vertices = 0;
+	const unsigned int* Indices = 0;
+};
+
+// Helpers for finding, reading and writing mesh cache files
+std::wstring GetMeshCachePath(const std::wstring& sourceFile, unsigned long long& sourceHash);
+bool LoadMeshCache(const std::wstring& cacheFile, unsigned long long sourceHash, MeshCacheView& view);
+bool SaveMeshCache(const std::wstring& cacheFile, unsigned long long sourceHash,
+	const Vertex* verts, size_t numVerts, const unsigned int* indices, size_t numIndices,
+	DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
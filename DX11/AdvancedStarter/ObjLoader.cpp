@@ -0,0 +1,443 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+
+#include <DirectXMath.h>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+
+// Chunks smaller than this aren't worth a thread of their own
+static const size_t MinChunkBytes = 1 << 20;
+
+// --------------------------------------------------------
+// One corner of a face: 0-based indices into the whole
+// file's positions, uvs and normals, with -1 for a uv or
+// normal the face doesn't give
+// --------------------------------------------------------
+struct ObjCorner
+{
+	int Position;
+	int UV;
+	int Normal;
+
+	bool operator==(const ObjCorner& other) const
+	{
+		return Position == other.Position && UV == other.UV && Normal == other.Normal;
+	}
+};
+
+// --------------------------------------------------------
+// Everything read from one chunk of the file.  Chunks are
+// parsed at the same time, so indices can only be made
+// absolute once every chunk before them has been counted.
+// --------------------------------------------------------
+struct ObjChunk
+{
+	const char* start;
+	const char* end;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT2> uvs;
+	std::vector<XMFLOAT3> normals;
+	std::vector<ObjCorner> corners;       // Corners of every face, face after face
+	std::vector<unsigned int> faceSizes;  // Number of corners in each face
+
+	// Corners using negative (relative) indices, which are only
+	// relative to this chunk's data so far, and which of their
+	// indices (bits 0-2: position, uv, normal) need the offset
+	std::vector<std::pair<size_t, unsigned char>> relativeCorners;
+
+	bool missingNormals = false;  // Did any corner come without a normal?
+	size_t badLines = 0;          // Lines that couldn't be fully read
+};
+
+
+// --------------------------------------------------------
+// Small parsing helpers that never read past the end of
+// the chunk.  Spaces and tabs separate values, but line
+// breaks stop them.
+// --------------------------------------------------------
+static const char* SkipSpaces(const char* c, const char* end)
+{
+	while (c < end && (*c == ' ' || *c == '\t'))
+		c++;
+	return c;
+}
+
+static const char* NextLine(const char* c, const char* end)
+{
+	const char* newline = (const char*)memchr(c, '\n', end - c);
+	return newline ? newline + 1 : end;
+}
+
+static bool ReadFloat(const char*& c, const char* end, float& value)
+{
+	c = SkipSpaces(c, end);
+	if (c < end && *c == '+')
+		c++;
+
+	std::from_chars_result result = std::from_chars(c, end, value);
+	if (result.ec != std::errc())
+		return false;
+	c = result.ptr;
+	return true;
+}
+
+static bool ReadIndex(const char*& c, const char* end, int& value)
+{
+	std::from_chars_result result = std::from_chars(c, end, value);
+	if (result.ec != std::errc() || value == 0)
+		return false;
+	c = result.ptr;
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads a face's index and makes it 0-based.  Negative
+// indices count back from the data read so far, which is
+// only known within this chunk for now.
+// --------------------------------------------------------
+static bool ReadCornerIndex(const char*& c, const char* end, size_t count, int& index, bool& relative)
+{
+	int value = 0;
+	if (!ReadIndex(c, end, value))
+		return false;
+
+	relative = value < 0;
+	index = relative ? (int)count + value : value - 1;
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Adds a chunk's data to the end of the file's, taking the
+// chunk's memory outright when it's the first
+// --------------------------------------------------------
+template <typename T>
+static void Append(std::vector<T>& all, std::vector<T>& chunk)
+{
+	if (all.empty())
+		all.swap(chunk);
+	else
+		all.insert(all.end(), chunk.begin(), chunk.end());
+}
+
+
+// --------------------------------------------------------
+// Parses every line that starts within [start, end)
+// --------------------------------------------------------
+static void ParseChunk(ObjChunk& chunk)
+{
+	const char* end = chunk.end;
+	for (const char* line = chunk.start; line < end; line = NextLine(line, end))
+	{
+		const char* c = SkipSpaces(line, end);
+		if (end - c < 2)
+			continue;
+
+		if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t'))
+		{
+			// Position - always added, even if broken, so later indices stay correct
+			XMFLOAT3 pos = { 0, 0, 0 };
+			c++;
+			if (!ReadFloat(c, end, pos.x) || !ReadFloat(c, end, pos.y) || !ReadFloat(c, end, pos.z))
+				chunk.badLines++;
+			chunk.positions.push_back(pos);
+		}
+		else if (c[0] == 'v' && c[1] == 't')
+		{
+			// UV - any third (w) coordinate is ignored
+			XMFLOAT2 uv = { 0, 0 };
+			c += 2;
+			if (!ReadFloat(c, end, uv.x) || !ReadFloat(c, end, uv.y))
+				chunk.badLines++;
+			chunk.uvs.push_back(uv);
+		}
+		else if (c[0] == 'v' && c[1] == 'n')
+		{
+			XMFLOAT3 norm = { 0, 0, 0 };
+			c += 2;
+			if (!ReadFloat(c, end, norm.x) || !ReadFloat(c, end, norm.y) || !ReadFloat(c, end, norm.z))
+				chunk.badLines++;
+			chunk.normals.push_back(norm);
+		}
+		else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+		{
+			// Any number of corners, each "v", "v/vt", "v//vn" or "v/vt/vn"
+			size_t firstCorner = chunk.corners.size();
+			size_t firstRelative = chunk.relativeCorners.size();
+			bool valid = true;
+			c++;
+			while (true)
+			{
+				c = SkipSpaces(c, end);
+				if (c == end || *c == '\r' || *c == '\n' || *c == '#')
+					break;
+
+				ObjCorner corner = { -1, -1, -1 };
+				unsigned char relativeMask = 0;
+				bool relative = false;
+				valid = ReadCornerIndex(c, end, chunk.positions.size(), corner.Position, relative);
+				relativeMask |= relative ? 1 : 0;
+				if (valid && c < end && *c == '/')
+				{
+					c++;
+					if (c < end && *c != '/')
+					{
+						valid = ReadCornerIndex(c, end, chunk.uvs.size(), corner.UV, relative);
+						relativeMask |= relative ? 2 : 0;
+					}
+					if (valid && c < end && *c == '/')
+					{
+						c++;
+						valid = ReadCornerIndex(c, end, chunk.normals.size(), corner.Normal, relative);
+						relativeMask |= relative ? 4 : 0;
+					}
+				}
+				if (!valid)
+					break;
+
+				if (relativeMask != 0)
+					chunk.relativeCorners.push_back({ chunk.corners.size(), relativeMask });
+				chunk.missingNormals |= corner.Normal == -1;
+				chunk.corners.push_back(corner);
+			}
+
+			// Drop faces that can't make a triangle or couldn't be read
+			size_t cornerCount = chunk.corners.size() - firstCorner;
+			if (!valid || cornerCount < 3)
+			{
+				chunk.corners.resize(firstCorner);
+				chunk.relativeCorners.resize(firstRelative);
+				chunk.badLines++;
+				continue;
+			}
+			chunk.faceSizes.push_back((unsigned int)cornerCount);
+		}
+
+		// Anything else (comments, groups, materials, etc.) is skipped
+	}
+}
+
+
+// --------------------------------------------------------
+// Loads the given .obj file.  See ObjLoader.h for details.
+//
+// objFile - Path to the .obj 3D model file to load
+// verts   - Receives the unique vertices of the model
+// indices - Receives three indices per triangle
+// --------------------------------------------------------
+bool LoadObj(const std::wstring& objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	MappedFile file(objFile);
+	if (!file.IsOpen())
+	{
+		printf("Could not open OBJ file %ls\n", objFile.c_str());
+		return false;
+	}
+	const char* data = file.GetData();
+	const char* dataEnd = data + file.GetSize();
+
+	// Split the file into one chunk per hardware thread (if it's big
+	// enough), each ending at a line break so no line is split
+	size_t threadCount = std::thread::hardware_concurrency();
+	size_t chunkCount = file.GetSize() / MinChunkBytes;
+	if (chunkCount > threadCount) chunkCount = threadCount;
+	if (chunkCount < 1) chunkCount = 1;
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* chunkStart = data;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = i + 1 == chunkCount ? dataEnd : NextLine(data + file.GetSize() / chunkCount * (i + 1), dataEnd);
+		if (chunkEnd < chunkStart)
+			chunkEnd = chunkStart;
+		chunks[i].start = chunkStart;
+		chunks[i].end = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	// Parse them all at once, this thread taking the first
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < chunkCount; i++)
+		threads.emplace_back(ParseChunk, std::ref(chunks[i]));
+	ParseChunk(chunks[0]);
+	for (std::thread& t : threads)
+		t.join();
+
+	// Stitch the chunks together, making each chunk's relative
+	// indices absolute now that the data before it is counted
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT2> uvs;
+	std::vector<XMFLOAT3> normals;
+	std::vector<ObjCorner> corners;
+	std::vector<unsigned int> faceSizes;
+	size_t totals[5] = {};
+	size_t badLines = 0;
+	bool missingNormals = false;
+	for (ObjChunk& chunk : chunks)
+	{
+		totals[0] += chunk.positions.size();
+		totals[1] += chunk.uvs.size();
+		totals[2] += chunk.normals.size();
+		totals[3] += chunk.corners.size();
+		totals[4] += chunk.faceSizes.size();
+	}
+	if (chunkCount > 1)
+	{
+		positions.reserve(totals[0]);
+		uvs.reserve(totals[1]);
+		normals.reserve(totals[2]);
+		corners.reserve(totals[3]);
+		faceSizes.reserve(totals[4]);
+	}
+
+	for (ObjChunk& chunk : chunks)
+	{
+		int positionOffset = (int)positions.size();
+		int uvOffset = (int)uvs.size();
+		int normalOffset = (int)normals.size();
+		for (const std::pair<size_t, unsigned char>& relative : chunk.relativeCorners)
+		{
+			ObjCorner& corner = chunk.corners[relative.first];
+			if (relative.second & 1) corner.Position += positionOffset;
+			if (relative.second & 2) corner.UV += uvOffset;
+			if (relative.second & 4) corner.Normal += normalOffset;
+		}
+
+		Append(positions, chunk.positions);
+		Append(uvs, chunk.uvs);
+		Append(normals, chunk.normals);
+		Append(corners, chunk.corners);
+		Append(faceSizes, chunk.faceSizes);
+		badLines += chunk.badLines;
+		missingNormals |= chunk.missingNormals;
+		chunk = ObjChunk();
+	}
+
+	// Every index has to point at something that exists
+	for (const ObjCorner& corner : corners)
+	{
+		if (corner.Position < 0 || corner.Position >= (int)positions.size() ||
+			corner.UV < -1 || corner.UV >= (int)uvs.size() ||
+			corner.Normal < -1 || corner.Normal >= (int)normals.size())
+		{
+			printf("OBJ file %ls has a face index out of range\n", objFile.c_str());
+			return false;
+		}
+	}
+
+	// Corners without normals get smooth ones: the area-weighted
+	// average of the faces around their position
+	std::vector<XMFLOAT3> positionNormals;
+	if (missingNormals)
+	{
+		positionNormals.resize(positions.size(), XMFLOAT3(0, 0, 0));
+		size_t faceStart = 0;
+		for (unsigned int faceSize : faceSizes)
+		{
+			for (unsigned int i = 1; i + 1 < faceSize; i++)
+			{
+				XMVECTOR p0 = XMLoadFloat3(&positions[corners[faceStart].Position]);
+				XMVECTOR p1 = XMLoadFloat3(&positions[corners[faceStart + i].Position]);
+				XMVECTOR p2 = XMLoadFloat3(&positions[corners[faceStart + i + 1].Position]);
+				XMFLOAT3 faceNormal;
+				XMStoreFloat3(&faceNormal, XMVector3Cross(p1 - p0, p2 - p0));
+				for (size_t c : { faceStart, faceStart + i, faceStart + i + 1 })
+				{
+					XMFLOAT3& n = positionNormals[corners[c].Position];
+					n.x += faceNormal.x;
+					n.y += faceNormal.y;
+					n.z += faceNormal.z;
+				}
+			}
+			faceStart += faceSize;
+		}
+		for (XMFLOAT3& n : positionNormals)
+			XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+	}
+
+	// Each unique combination of position, uv and normal indices
+	// becomes one vertex, shared by every face corner that uses it.
+	// Corners can only share a vertex if they share a position, so
+	// the vertices made so far are chained per position, and only
+	// those few are searched - a hash table keyed by position index.
+	verts.clear();
+	indices.clear();
+	std::vector<int> firstVertexAt(positions.size(), -1);  // Latest vertex made at each position
+	std::vector<int> nextVertexAt;                         // Previous vertex made at the same position
+	std::vector<ObjCorner> vertexCorners;                  // The corner each vertex was made from
+	std::vector<unsigned int> cornerVertices(corners.size());
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		// Already made this vertex?
+		const ObjCorner& corner = corners[i];
+		int existing = firstVertexAt[corner.Position];
+		while (existing != -1 && !(vertexCorners[existing] == corner))
+			existing = nextVertexAt[existing];
+		if (existing != -1)
+		{
+			cornerVertices[i] = (unsigned int)existing;
+			continue;
+		}
+
+		cornerVertices[i] = (unsigned int)verts.size();
+		nextVertexAt.push_back(firstVertexAt[corner.Position]);
+		firstVertexAt[corner.Position] = (int)verts.size();
+		vertexCorners.push_back(corner);
+
+		// Create the vert by looking up corresponding data from vectors
+		// - Corners without a texture coordinate get (0,0), which leaves
+		//   their tangent to be derived from the normal alone
+		Vertex v = {};
+		v.Position = positions[corner.Position];
+		v.UV = corner.UV == -1 ? XMFLOAT2(0, 0) : uvs[corner.UV];
+		v.Normal = corner.Normal == -1 ? positionNormals[corner.Position] : normals[corner.Normal];
+
+		// The model is most likely in a right-handed space,
+		// especially if it came from Maya.  We want to convert
+		// to a left-handed space for DirectX.  This means we
+		// need to:
+		//  - Invert the Z position
+		//  - Invert the normal's Z
+		//  - Flip the winding order (done per face, below)
+		// We also need to flip the UV coordinate since DirectX
+		// defines (0,0) as the top left of the texture, and many
+		// 3D modeling packages use the bottom left as (0,0)
+		v.UV.y = 1.0f - v.UV.y;
+		v.Position.z *= -1.0f;
+		v.Normal.z *= -1.0f;
+		verts.push_back(v);
+	}
+
+	// Split each face into a fan of triangles (flipping the winding order)
+	size_t triangleCount = 0;
+	for (unsigned int faceSize : faceSizes)
+		triangleCount += faceSize - 2;
+	indices.reserve(triangleCount * 3);
+
+	size_t faceStart = 0;
+	for (unsigned int faceSize : faceSizes)
+	{
+		for (unsigned int i = 1; i + 1 < faceSize; i++)
+		{
+			indices.push_back(cornerVertices[faceStart]);
+			indices.push_back(cornerVertices[faceStart + i + 1]);
+			indices.push_back(cornerVertices[faceStart + i]);
+		}
+		faceStart += faceSize;
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	printf("Loaded %ls: %zu triangles, %zu vertices, %.1f ms (%.0f MB/s on %zu threads)\n",
+		objFile.c_str(), triangleCount, verts.size(), ms, file.GetSize() / 1048576.0 / (ms / 1000.0), chunkCount);
+	if (badLines > 0)
+		printf("  Skipped or partially read %zu malformed lines\n", badLines);
+	return true;
+}
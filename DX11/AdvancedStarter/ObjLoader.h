@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Loads the triangles of an .obj file as a deduplicated
+// vertex list and indices, already converted to DirectX's
+// left-handed coordinates and top-left UV origin
+//
+// Tangents are left at zero, to be calculated once the
+// indices are known.  Returns false if the file can't be
+// read or refers to data it doesn't contain.
+// --------------------------------------------------------
+bool LoadObj(const std::wstring& objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
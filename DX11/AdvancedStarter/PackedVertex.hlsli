@@ -0,0 +1,30 @@
+// Include guard
+#ifndef _PACKED_VERTEX_HLSL
+#define _PACKED_VERTEX_HLSL
+
+// Struct representing a single PackedVertex from C++, as
+// the input layout hands it over (already converted to floats)
+struct PackedVertexShaderInput
+{
+	float4 position			: POSITION;			// 0-1 across the mesh's bounds
+	float2 uv				: TEXCOORD;
+	float4 normalTangent	: NORMALTANGENT;	// Octahedral normal (XY) and tangent (ZW)
+};
+
+// Turns a 0-1 position back into the mesh's local space
+float3 DecodePosition(float4 position, float3 boundsMin, float3 boundsMax)
+{
+	return lerp(boundsMin, boundsMax, position.xyz);
+}
+
+// Unfolds an octahedral-encoded direction - must
+// match DecodeOctahedral() in Mesh.cpp
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 dir = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float t = saturate(-dir.z);
+	dir.xy += (dir.xy >= 0.0f) ? -t : t;
+	return normalize(dir);
+}
+
+#endif
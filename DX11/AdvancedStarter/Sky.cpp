@@ -117,6 +117,11 @@ void Sky::Draw(std::shared_ptr<Camera> camera)
 	// Give them proper data
 	skyVS->SetMatrix4x4("view", camera->GetView());
 	skyVS->SetMatrix4x4("projection", camera->GetProjection());
+	if (skyMesh->IsPacked())
+	{
+		skyVS->SetFloat3("boundsMin", skyMesh->GetBoundsMin());
+		skyVS->SetFloat3("boundsMax", skyMesh->GetBoundsMax());
+	}
 	skyVS->CopyAllBufferData();
 
 	// Send the proper resources to the pixel shader
@@ -0,0 +1,46 @@
+#include "PackedVertex.hlsli"
+
+// Same as SkyVS.hlsl's external data, plus the
+// mesh's bounds for decoding positions
+cbuffer ExternalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+	float3 boundsMin;
+	float3 boundsMax;
+}
+
+// Struct representing the data we're sending down the pipeline
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;	// XYZW position (System Value Position)
+	float3 sampleDir	: DIRECTION;
+};
+
+// --------------------------------------------------------
+// The same as SkyVS.hlsl, but for meshes made of PackedVertex
+// --------------------------------------------------------
+VertexToPixel main(PackedVertexShaderInput input)
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	// Only the position is needed from the packed vertex
+	float3 position = DecodePosition(input.position, boundsMin, boundsMax);
+
+	// Modify the view matrix and remove the translation portion
+	matrix viewNoTranslation = view;
+	viewNoTranslation._14 = 0;
+	viewNoTranslation._24 = 0;
+	viewNoTranslation._34 = 0;
+
+	// Multiply the view (without translation) and the projection,
+	// putting the sky vertex ON the far clip plane (Z = W)
+	matrix vp = mul(projection, viewNoTranslation);
+	output.position = mul(vp, float4(position, 1.0f));
+	output.position.z = output.position.w;
+
+	// Use the vert's position as the sample direction for the cube map!
+	output.sampleDir = position;
+	return output;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <d3d11.h>
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 // --------------------------------------------------------
 // A custom vertex definition
@@ -13,4 +15,26 @@ struct Vertex
 	DirectX::XMFLOAT2 UV;			// Texture mapping
 	DirectX::XMFLOAT3 Normal;		// Lighting
 	DirectX::XMFLOAT3 Tangent;		// Normal mapping
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// A compact version of Vertex: 16 bytes instead of 44
+//
+// Meshes created with packing turned on convert their
+// vertices to this when building their buffers, and need
+// a vertex shader that decodes it (see PackedVertex.hlsli)
+// --------------------------------------------------------
+struct PackedVertex
+{
+	DirectX::PackedVector::XMUSHORTN4 Position;		// 0-1 across the mesh's bounds (W unused)
+	DirectX::PackedVector::XMHALF2 UV;				// Half floats
+	DirectX::PackedVector::XMBYTEN4 NormalTangent;	// Octahedral normal (XY) and tangent (ZW)
+};
+
+// Input layout description matching PackedVertex
+const D3D11_INPUT_ELEMENT_DESC PackedVertexLayout[] =
+{
+	{ "POSITION",		0, DXGI_FORMAT_R16G16B16A16_UNORM,	0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD",		0, DXGI_FORMAT_R16G16_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMALTANGENT",	0, DXGI_FORMAT_R8G8B8A8_SNORM,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
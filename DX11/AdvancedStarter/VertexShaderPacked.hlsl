@@ -0,0 +1,56 @@
+#include "PackedVertex.hlsli"
+
+// Constant Buffer for external (C++) data
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix worldInverseTranspose;
+	matrix view;
+	matrix projection;
+
+	// The mesh's bounds, for decoding positions
+	float3 boundsMin;
+	float3 boundsMax;
+};
+
+// Out of the vertex shader (and eventually input to the PS)
+struct VertexToPixel
+{
+	float4 screenPosition	: SV_POSITION;
+	float2 uv				: TEXCOORD;
+	float3 normal			: NORMAL;
+	float3 tangent			: TANGENT;
+	float3 worldPos			: POSITION; // The world position of this vertex
+};
+
+// --------------------------------------------------------
+// The same as VertexShader.hlsl, but for meshes made
+// of PackedVertex, which are decoded first
+// --------------------------------------------------------
+VertexToPixel main(PackedVertexShaderInput input)
+{
+	// Set up output
+	VertexToPixel output;
+
+	// Unpack the vertex
+	float3 position = DecodePosition(input.position, boundsMin, boundsMax);
+	float3 normal = DecodeOctahedral(input.normalTangent.xy);
+	float3 tangent = DecodeOctahedral(input.normalTangent.zw);
+
+	// Calculate output position
+	matrix worldViewProj = mul(projection, mul(view, world));
+	output.screenPosition = mul(worldViewProj, float4(position, 1.0f));
+
+	// Calculate the world position of this vertex (to be used
+	// in the pixel shader when we do point/spot lights)
+	output.worldPos = mul(world, float4(position, 1.0f)).xyz;
+
+	// Make sure the other vectors are in WORLD space, not "local" space
+	output.normal = normalize(mul((float3x3)worldInverseTranspose, normal));
+	output.tangent = normalize(mul((float3x3)world, tangent)); // Tangent doesn't need inverse transpose!
+
+	// Pass the UV through
+	output.uv = input.uv;
+
+	return output;
+}
@@ -1,10 +1,13 @@
 #include <DirectXMath.h>
 #include <vector>
 #include <fstream>
+#include <cstdio>
+#include <cmath>
 
 #include "Mesh.h"
 #include "DX12Helper.h"
 #include "RaytracingHelper.h"
+#include "../../MeshOptimizer/MeshOptimizer.h"
 
 using namespace DirectX;
 
@@ -191,11 +194,19 @@ vertexCount(0)
 		}
 	}
 
-	// Close the file and create the actual buffers
+	// Close the file
 	obj.close();
 
-	// Will vertices.data() and indices.data() work?
-	CreateBuffers(&vertices[0], vertCounter, &indices[0], vertCounter);
+	// Every face corner got its own vertex above, so merge the
+	// identical ones and then reorder it all for the GPU's caches
+	size_t uniqueCount = DeduplicateVertices(&vertices[0], vertices.size(), sizeof(Vertex), &indices[0], indices.size());
+	VertexCacheStats before, after;
+	uniqueCount = OptimizeMesh(&vertices[0], uniqueCount, sizeof(Vertex), &indices[0], indices.size(), before, after);
+	printf("Optimized %ls: %u -> %zu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		objFile.c_str(), vertCounter, uniqueCount, before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+
+	// Create the actual buffers
+	CreateBuffers(&vertices[0], uniqueCount, &indices[0], indices.size());
 }
 
 
@@ -245,7 +256,7 @@ void Mesh::CalculateTangents(Vertex* vertices, size_t vertexCount, UINT* indices
 	}
 
 	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < vertexCount;)
+	for (int i = 0; i < indexCount;)
 	{
 		// Grab indices and vertices of first triangle
 		unsigned int i1 = indices[i++];
@@ -271,8 +282,15 @@ void Mesh::CalculateTangents(Vertex* vertices, size_t vertexCount, UINT* indices
 		float s2 = v3->UV.x - v1->UV.x;
 		float t2 = v3->UV.y - v1->UV.y;
 
+		// Skip triangles whose UVs don't span an area (or are missing),
+		// as they give no tangent direction and the division would
+		// spread NaNs through every vertex they share
+		float uvArea = s1 * t2 - s2 * t1;
+		if (!(fabsf(uvArea) > 1e-12f))
+			continue;
+
 		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
+		float r = 1.0f / uvArea;
 
 		float tx = (t2 * x1 - t1 * x2) * r;
 		float ty = (t2 * y1 - t1 * y2) * r;
@@ -0,0 +1,401 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Marks a vertex that hasn't been given a new index yet
+static const unsigned int Unassigned = ~0u;
+
+
+// --------------------------------------------------------
+// A FIFO post-transform cache, simulated with timestamps:
+// a vertex is cached if it missed within the last
+// cacheSize misses.  Reset() empties it without touching
+// every vertex.
+// --------------------------------------------------------
+class VertexCacheSimulator
+{
+public:
+	VertexCacheSimulator(size_t vertexCount, unsigned int cacheSize) :
+		missTime(vertexCount, 0),
+		time(cacheSize + 1),
+		cacheSize(cacheSize)
+	{
+	}
+
+	// Returns true if the vertex had to be transformed
+	bool Access(unsigned int vertex)
+	{
+		if (time - missTime[vertex] <= cacheSize)
+			return false;
+
+		missTime[vertex] = time++;
+		return true;
+	}
+
+	unsigned int AccessTriangle(const unsigned int* triangle)
+	{
+		return Access(triangle[0]) + Access(triangle[1]) + Access(triangle[2]);
+	}
+
+	void Reset() { time += cacheSize + 1; }
+
+private:
+	std::vector<unsigned int> missTime;
+	unsigned int time;
+	unsigned int cacheSize;
+};
+
+
+// --------------------------------------------------------
+// Measures an index order's ACMR and ATVR in a FIFO cache
+// of the given size.  ATVR only counts vertices that the
+// indices actually use.
+// --------------------------------------------------------
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+	VertexCacheSimulator cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	size_t misses = 0;
+	size_t usedCount = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		misses += cache.Access(indices[i]);
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			usedCount++;
+		}
+	}
+
+	if (indexCount >= 3)
+		stats.ACMR = (float)misses / (indexCount / 3);
+	if (usedCount > 0)
+		stats.ATVR = (float)misses / usedCount;
+	return stats;
+}
+
+
+// --------------------------------------------------------
+// Merges vertices whose bytes are identical, such as the
+// per-corner copies made by an unindexed loader, and fixes
+// the indices to match.  Vertices keep the order in which
+// they first appear.  Returns the new vertex count.
+// --------------------------------------------------------
+size_t DeduplicateVertices(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount)
+{
+	char* bytes = (char*)vertices;
+
+	// An open-addressing hash table of unique vertices, at most half full
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize *= 2;
+	std::vector<unsigned int> table(tableSize, Unassigned);
+
+	std::vector<unsigned int> remap(vertexCount);
+	unsigned int uniqueCount = 0;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		// FNV-1a over the vertex's bytes
+		const char* vertex = bytes + v * vertexSize;
+		unsigned long long hash = 14695981039346656037ull;
+		for (size_t b = 0; b < vertexSize; b++)
+			hash = (hash ^ (unsigned char)vertex[b]) * 1099511628211ull;
+
+		// Find it, or the empty slot where it belongs
+		size_t slot = (size_t)hash & (tableSize - 1);
+		while (table[slot] != Unassigned && memcmp(bytes + table[slot] * vertexSize, vertex, vertexSize) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == Unassigned)
+		{
+			// New vertex - slide it down next to the other unique ones
+			if (uniqueCount != v)
+				memcpy(bytes + uniqueCount * vertexSize, vertex, vertexSize);
+			table[slot] = uniqueCount++;
+		}
+		remap[v] = table[slot];
+	}
+
+	for (size_t i = 0; i < indexCount; i++)
+		indices[i] = remap[indices[i]];
+	return uniqueCount;
+}
+
+
+// --------------------------------------------------------
+// Reorders triangles for the post-transform vertex cache
+// with Tipsify (Sander, Nehab & Barczak, "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw",
+// 2007): fan out around one vertex at a time, moving next
+// to a vertex that will still be cached once its remaining
+// triangles are drawn.  Runs in linear time.
+// --------------------------------------------------------
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles still to be drawn around each vertex, and the
+	// list of all of them, packed by vertex
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<unsigned int> deadEnds;     // Recently used vertices, to restart from when stuck
+	std::vector<unsigned int> candidates;   // Vertices of the fan just drawn
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	deadEnds.reserve(triangleCount * 3);
+
+	unsigned int time = cacheSize + 1;
+	size_t cursor = 0;
+	long long fanning = indices[0];
+	while (fanning >= 0)
+	{
+		// Draw every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// Next, the candidate furthest along in the cache that will
+		// still be there after its own fan (about 2 misses per triangle)
+		fanning = -1;
+		long long bestPriority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			long long priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = time - cacheTime[v];
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+
+		// Stuck?  Back up to a recent vertex with triangles left,
+		// or failing that, the next one in the mesh
+		while (fanning < 0 && !deadEnds.empty())
+		{
+			unsigned int v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0)
+				fanning = v;
+		}
+		while (fanning < 0 && cursor < vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+				fanning = cursor;
+			cursor++;
+		}
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+
+// --------------------------------------------------------
+// Reorders groups of triangles so surfaces facing out from
+// the middle of the mesh tend to draw first and hide what's
+// behind them, from any view (the cluster sort of the same
+// Tipsify paper).  Groups are only split where starting
+// them with an empty cache keeps their ACMR within
+// `threshold` times what it was, so the vertex cache order
+// mostly survives.
+// --------------------------------------------------------
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize, float threshold, unsigned int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Hard boundaries: triangles that miss all three of their
+	// vertices, where the cache has effectively started over
+	std::vector<size_t> hardClusters;
+	VertexCacheSimulator cache(vertexCount, cacheSize);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (cache.AccessTriangle(indices + t * 3) == 3)
+			hardClusters.push_back(t);
+	}
+	if (hardClusters.empty() || hardClusters[0] != 0)
+		hardClusters.insert(hardClusters.begin(), 0);
+	hardClusters.push_back(triangleCount);
+
+	// Soft boundaries: split each of those wherever the part so
+	// far, drawn from an empty cache, is nearly as good as the whole
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hardClusters.size(); h++)
+	{
+		size_t start = hardClusters[h];
+		size_t end = hardClusters[h + 1];
+
+		cache.Reset();
+		unsigned int misses = 0;
+		for (size_t t = start; t < end; t++)
+			misses += cache.AccessTriangle(indices + t * 3);
+		float limit = (float)misses / (end - start) * threshold;
+
+		cache.Reset();
+		clusters.push_back(start);
+		size_t clusterStart = start;
+		unsigned int clusterMisses = 0;
+		for (size_t t = start; t + 1 < end; t++)
+		{
+			clusterMisses += cache.AccessTriangle(indices + t * 3);
+			if ((float)clusterMisses / (t + 1 - clusterStart) <= limit)
+			{
+				clusters.push_back(t + 1);
+				clusterStart = t + 1;
+				clusterMisses = 0;
+				cache.Reset();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// Area-weighted centers and normals, of each cluster and the mesh
+	const char* bytes = (const char*)vertices;
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<float> clusterData(clusterCount * 7, 0.0f);  // Center * area, normal * area, area
+	float meshCenter[3] = {};
+	float meshArea = 0;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float* data = &clusterData[c * 7];
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const float* p0 = (const float*)(bytes + indices[t * 3 + 0] * vertexSize);
+			const float* p1 = (const float*)(bytes + indices[t * 3 + 1] * vertexSize);
+			const float* p2 = (const float*)(bytes + indices[t * 3 + 2] * vertexSize);
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+			// Clockwise front faces in a left-handed space, so this faces out
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int i = 0; i < 3; i++)
+			{
+				float center = (p0[i] + p1[i] + p2[i]) / 3.0f;
+				data[i] += center * area;
+				data[3 + i] += n[i];
+				meshCenter[i] += center * area;
+			}
+			data[6] += area;
+			meshArea += area;
+		}
+	}
+	if (meshArea > 0)
+	{
+		for (int i = 0; i < 3; i++)
+			meshCenter[i] /= meshArea;
+	}
+
+	// The further out a cluster sits along the way it faces, the
+	// more likely it is to cover the rest of the mesh
+	std::vector<float> sortKeys(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		const float* data = &clusterData[c * 7];
+		float normalLength = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+		if (normalLength == 0 || data[6] == 0)
+			continue;
+
+		float key = 0;
+		for (int i = 0; i < 3; i++)
+			key += (data[i] / data[6] - meshCenter[i]) * data[3 + i];
+		sortKeys[c] = key / normalLength;
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	for (size_t c : order)
+		output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+	memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+
+// --------------------------------------------------------
+// Renumbers vertices in the order the indices first use
+// them and moves them to match, so vertex fetches walk
+// forward through memory.  Vertices no index uses are
+// dropped.  Returns the new vertex count.
+// --------------------------------------------------------
+size_t OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount)
+{
+	std::vector<unsigned int> remap(vertexCount, Unassigned);
+	unsigned int nextVertex = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int& newIndex = remap[indices[i]];
+		if (newIndex == Unassigned)
+			newIndex = nextVertex++;
+		indices[i] = newIndex;
+	}
+
+	char* bytes = (char*)vertices;
+	std::vector<char> original(bytes, bytes + vertexCount * vertexSize);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] != Unassigned)
+			memcpy(bytes + remap[v] * vertexSize, &original[v * vertexSize], vertexSize);
+	}
+	return nextVertex;
+}
+
+
+// --------------------------------------------------------
+// Runs all three optimization steps in order, measuring the
+// vertex cache before and after.  Returns the new vertex
+// count, which drops if some vertices were never used.
+// --------------------------------------------------------
+size_t OptimizeMesh(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount,
+	VertexCacheStats& before, VertexCacheStats& after)
+{
+	before = AnalyzeVertexCache(indices, indexCount, vertexCount);
+	OptimizeVertexCache(indices, indexCount, vertexCount);
+	OptimizeOverdraw(indices, indexCount, vertices, vertexCount, vertexSize);
+	vertexCount = OptimizeVertexFetch(vertices, vertexCount, vertexSize, indices, indexCount);
+	after = AnalyzeVertexCache(indices, indexCount, vertexCount);
+	return vertexCount;
+}
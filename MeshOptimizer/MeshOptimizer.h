@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// Mesh optimization steps, run once after a mesh is
+// imported and before its buffers are created.  They work
+// on plain index arrays and raw vertex bytes, so any
+// project's Vertex struct can use them, as long as it
+// starts with its position as three floats.
+//
+// The usual order is what OptimizeMesh() does:
+//  - OptimizeVertexCache, so each vertex shader result is
+//     reused by as many triangles as possible
+//  - OptimizeOverdraw, which moves whole groups of those
+//     triangles so outer surfaces tend to draw first
+//  - OptimizeVertexFetch, so vertices are read in order
+// --------------------------------------------------------
+
+// Size of the post-transform cache the steps plan for, as a
+// FIFO.  Real GPUs vary, but orders that do well at this size
+// do well on them too.
+const unsigned int VertexCacheSize = 16;
+
+// --------------------------------------------------------
+// How well an index order uses the post-transform cache
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float ACMR;  // Average cache miss ratio: vertex shader runs per triangle (3 is the worst)
+	float ATVR;  // Average transformed vertex ratio: vertex shader runs per vertex (1 is ideal)
+};
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VertexCacheSize);
+
+size_t DeduplicateVertices(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount);
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VertexCacheSize);
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize, float threshold = 1.05f, unsigned int cacheSize = VertexCacheSize);
+size_t OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount);
+
+size_t OptimizeMesh(void* vertices, size_t vertexCount, size_t vertexSize, unsigned int* indices, size_t indexCount,
+	VertexCacheStats& before, VertexCacheStats& after);
@@ -0,0 +1,81 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "rtweekend.h"
+
+template <typename T>
+class basic_aabb {
+public:
+    basic_interval<T> x, y, z;
+
+    basic_aabb() {} // The default AABB is empty, since intervals are empty by default.
+
+    basic_aabb(const basic_interval<T>& ix, const basic_interval<T>& iy, const basic_interval<T>& iz)
+        : x(ix), y(iy), z(iz) {}
+
+    basic_aabb(const basic_point3<T>& a, const basic_point3<T>& b) {
+        // Treat the two points a and b as extrema for the bounding box, so we don't require a
+        // particular minimum/maximum coordinate order.
+        x = basic_interval<T>(fmin(a[0], b[0]), fmax(a[0], b[0]));
+        y = basic_interval<T>(fmin(a[1], b[1]), fmax(a[1], b[1]));
+        z = basic_interval<T>(fmin(a[2], b[2]), fmax(a[2], b[2]));
+    }
+
+    basic_aabb(const basic_aabb& box0, const basic_aabb& box1) {
+        x = basic_interval<T>(box0.x, box1.x);
+        y = basic_interval<T>(box0.y, box1.y);
+        z = basic_interval<T>(box0.z, box1.z);
+    }
+
+    const basic_interval<T>& axis(int n) const {
+        if (n == 1) return y;
+        if (n == 2) return z;
+        return x;
+    }
+
+    bool is_empty() const {
+        return x.min > x.max || y.min > y.max || z.min > z.max;
+    }
+
+    basic_point3<T> centroid() const {
+        return basic_point3<T>((x.min + x.max) / 2, (y.min + y.max) / 2, (z.min + z.max) / 2);
+    }
+
+    T surface_area() const {
+        if (is_empty()) return 0;
+        auto dx = x.size(), dy = y.size(), dz = z.size();
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    bool hit(const basic_ray<T>& r, const basic_vec3<T>& inv_dir, basic_interval<T> ray_t) const {
+        // Slab test; `inv_dir` is 1/direction, computed once per ray by the caller. The far
+        // distance is widened by the worst-case rounding error so a ray that touches a box
+        // exactly on its boundary (say, through a mesh vertex) is never rejected.
+        const T widen = 1 + 2 * gamma(3);
+        auto origin = r.origin();
+        for (int a = 0; a < 3; a++) {
+            const basic_interval<T>& ax = axis(a);
+            auto t0 = (ax.min - origin[a]) * inv_dir[a];
+            auto t1 = (ax.max - origin[a]) * inv_dir[a];
+            if (t0 > t1) std::swap(t0, t1);
+            t1 *= widen;
+
+            if (t0 > ray_t.min) ray_t.min = t0;
+            if (t1 < ray_t.max) ray_t.max = t1;
+            if (ray_t.max < ray_t.min)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr T gamma(int n) {
+        // Bound on the relative error of n rounded operations.
+        constexpr T unit_roundoff = std::numeric_limits<T>::epsilon() / 2;
+        return (n * unit_roundoff) / (1 - n * unit_roundoff);
+    }
+};
+
+using aabb = basic_aabb<double>;
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "Instance.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One camera setting at one frame.
+template <typename T>
+struct basic_camera_key {
+    enum setting : uint32_t { lookfrom, lookat, vup, vfov, defocus_angle, focus_dist };
+
+    int32_t frame = 0;
+    setting which = lookfrom;
+    basic_vec3<T> value;  // Angles and distances use x only
+};
+
+// An instance's whole transform at one frame, replacing the one its instance statement gave.
+template <typename T>
+struct basic_instance_key {
+    uint32_t instance = 0;  // Index among the scene's instances, in the order they were written
+    int32_t frame = 0;
+    std::vector<basic_transform_step<T>> steps;
+};
+
+// The keyframes of an animated scene. Each camera setting and each instance is blended linearly
+// between the keys around a frame, and holds its first or last key outside them.
+template <typename T>
+class basic_animation {
+public:
+    int frame_count = 0;  // Frames 0 to frame_count - 1; 0 for a still scene
+    std::vector<basic_camera_key<T>> camera_keys;
+    std::vector<basic_instance_key<T>> instance_keys;
+
+    // Sets the keyed camera settings for `frame` and leaves the others alone.
+    void apply_camera(int frame, basic_camera<T>& cam) const {
+        for (uint32_t which = basic_camera_key<T>::lookfrom; which <= basic_camera_key<T>::focus_dist; which++) {
+            const basic_camera_key<T>* before = nullptr;
+            const basic_camera_key<T>* after = nullptr;
+            for (const auto& key : camera_keys) {
+                if (key.which == which)
+                    bracket(key, frame, before, after);
+            }
+            if (before == nullptr && after == nullptr)
+                continue;
+
+            basic_vec3<T> value;
+            if (before == nullptr || after == nullptr || before->frame == after->frame)
+                value = (before != nullptr ? before : after)->value;
+            else
+                value = before->value + (after->value - before->value) * weight(before->frame, after->frame, frame);
+
+            switch (which) {
+            case basic_camera_key<T>::lookfrom: cam.lookfrom = value; break;
+            case basic_camera_key<T>::lookat: cam.lookat = value; break;
+            case basic_camera_key<T>::vup: cam.vup = value; break;
+            case basic_camera_key<T>::vfov: cam.vfov = value.x(); break;
+            case basic_camera_key<T>::defocus_angle: cam.defocus_angle = value.x(); break;
+            case basic_camera_key<T>::focus_dist: cam.focus_dist = value.x(); break;
+            }
+        }
+    }
+
+    // The transform of `instance` at `frame`, or false if it has no keys and stays where it is.
+    bool instance_transform(uint32_t instance, int frame, basic_transform<T>& object_to_world) const {
+        const basic_instance_key<T>* before = nullptr;
+        const basic_instance_key<T>* after = nullptr;
+        for (const auto& key : instance_keys) {
+            if (key.instance == instance)
+                bracket(key, frame, before, after);
+        }
+        if (before == nullptr && after == nullptr)
+            return false;
+
+        if (before == nullptr || after == nullptr || before->frame == after->frame) {
+            object_to_world = basic_transform_step<T>::compose((before != nullptr ? before : after)->steps);
+            return true;
+        }
+        T t = weight(before->frame, after->frame, frame);
+        std::vector<basic_transform_step<T>> steps(before->steps.size());
+        for (size_t i = 0; i < steps.size(); i++)
+            steps[i] = basic_transform_step<T>::blend(before->steps[i], after->steps[i], t);
+        object_to_world = basic_transform_step<T>::compose(steps);
+        return true;
+    }
+
+    // Checks what cannot be seen one key at a time: keys refer to existing instances, and all keys
+    // of an instance list the same kinds of step in the same order, so they can be blended.
+    // Returns an error message, or an empty string.
+    std::string validate(size_t instance_count) const {
+        for (size_t i = 0; i < instance_keys.size(); i++) {
+            const auto& key = instance_keys[i];
+            if (key.instance >= instance_count)
+                return "key for instance " + std::to_string(key.instance) + ", which does not exist";
+            for (size_t j = 0; j < i; j++) {
+                const auto& other = instance_keys[j];
+                if (other.instance != key.instance)
+                    continue;
+                bool same = other.steps.size() == key.steps.size();
+                for (size_t s = 0; same && s < key.steps.size(); s++)
+                    same = other.steps[s].type == key.steps[s].type;
+                if (!same)
+                    return "keys of instance " + std::to_string(key.instance) + " must list the same transforms in the same order";
+                break;
+            }
+        }
+        return std::string();
+    }
+
+private:
+    // Narrows the nearest keys at or before and at or after `frame` down with `key`.
+    template <typename Key>
+    static void bracket(const Key& key, int frame, const Key*& before, const Key*& after) {
+        if (key.frame <= frame && (before == nullptr || key.frame > before->frame))
+            before = &key;
+        if (key.frame >= frame && (after == nullptr || key.frame < after->frame))
+            after = &key;
+    }
+
+    static T weight(int from, int to, int frame) {
+        return static_cast<T>(frame - from) / static_cast<T>(to - from);
+    }
+};
+
+using camera_key = basic_camera_key<double>;
+using instance_key = basic_instance_key<double>;
+using animation = basic_animation<double>;
+
+#endif
@@ -0,0 +1,343 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "hittable.h"
+#include "HittableList.h"
+
+#include <algorithm>
+#include <vector>
+
+// Deepest a leaf can be below the root of a tree from basic_bvh_builder. Traversal pushes at most
+// one node per level, so a stack of this many entries always suffices.
+const int bvh_max_depth = 64;
+
+template <typename T>
+struct basic_bvh_flat_node {
+    basic_aabb<T> bbox;
+    int  offset;     // Leaf: first primitive index. Interior: index of the second child.
+    int  count;      // Leaf: primitive count. Interior: 0.
+    int  split_axis; // Interior only; the first child always directly follows its parent.
+};
+
+template <typename T>
+class basic_bvh_builder {
+public:
+    static const int bin_count = 16;
+    static const int max_leaf_size = 8;
+
+    // Builds a flattened BVH over the given primitive boxes with a binned surface-area
+    // heuristic. `order` receives the primitive indices in leaf order. Leaves that are tested
+    // `packet_width` primitives at a time cost a whole packet for any partial one, which the
+    // heuristic takes into account. No leaf ends up deeper than bvh_max_depth: where the heuristic
+    // would go past it, ranges are split at their median instead.
+    static void build(const std::vector<basic_aabb<T>>& boxes, std::vector<basic_bvh_flat_node<T>>& nodes, std::vector<int>& order,
+        int packet_width = 1)
+    {
+        nodes.clear();
+        order.resize(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+            order[i] = static_cast<int>(i);
+
+        std::vector<basic_point3<T>> centroids(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+            centroids[i] = boxes[i].centroid();
+
+        nodes.reserve(boxes.size() * 2);
+        if (!boxes.empty())
+            build_recursive(boxes, centroids, nodes, order, 0, static_cast<int>(boxes.size()), packet_width, 0);
+    }
+
+    // Depth of the deepest leaf below the root; at most bvh_max_depth for a tree from build().
+    static int depth(const std::vector<basic_bvh_flat_node<T>>& nodes) {
+        std::vector<int> depths(nodes.size(), 0);
+        int deepest = 0;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i].count > 0)
+                deepest = std::max(deepest, depths[i]);
+            else
+                depths[i + 1] = depths[nodes[i].offset] = depths[i] + 1;
+        }
+        return deepest;
+    }
+
+    // Recomputes every node's box bottom-up for primitives that have moved, keeping the tree's
+    // shape. `leaf_box(offset, count)` returns the current box of one leaf's primitives. Children
+    // always follow their parent, so a backwards sweep sees both children before the parent.
+    template <typename LeafBox>
+    static void refit(std::vector<basic_bvh_flat_node<T>>& nodes, LeafBox leaf_box) {
+        for (size_t i = nodes.size(); i-- > 0;) {
+            auto& node = nodes[i];
+            if (node.count > 0)
+                node.bbox = leaf_box(node.offset, node.count);
+            else
+                node.bbox = basic_aabb<T>(nodes[i + 1].bbox, nodes[node.offset].bbox);
+        }
+    }
+
+    // How far refits have let a tree go: the mean over interior nodes of how many times larger
+    // each one's surface area is than in `built`, the same tree as it came from build(). Primitives
+    // that moved apart make the nodes grouping them grow, and rays visit those nodes more often.
+    // Unlike the whole tree's SAH cost, this is not hidden by one huge box such as a ground plane
+    // that dwarfs every other node.
+    static double growth(const std::vector<basic_bvh_flat_node<T>>& nodes, const std::vector<basic_bvh_flat_node<T>>& built) {
+        double total = 0;
+        int count = 0;
+        for (size_t i = 0; i < nodes.size() && i < built.size(); i++) {
+            double before = built[i].bbox.surface_area();
+            if (nodes[i].count == 0 && before > 0) {
+                total += nodes[i].bbox.surface_area() / before;
+                ++count;
+            }
+        }
+        return count > 0 ? total / count : 1.0;
+    }
+
+private:
+    struct bin {
+        basic_aabb<T> bbox;
+        int  count = 0;
+    };
+
+    // Levels a range of `count` primitives needs below it when halved until it fits in leaves.
+    static int median_levels(int count) {
+        int levels = 0;
+        for (int leaves = (count + max_leaf_size - 1) / max_leaf_size; leaves > 1; leaves = (leaves + 1) / 2)
+            ++levels;
+        return levels;
+    }
+
+    static int build_recursive(const std::vector<basic_aabb<T>>& boxes, const std::vector<basic_point3<T>>& centroids,
+        std::vector<basic_bvh_flat_node<T>>& nodes, std::vector<int>& order, int begin, int end, int packet_width, int depth)
+    {
+        int node_index = static_cast<int>(nodes.size());
+        nodes.push_back(basic_bvh_flat_node<T>());
+
+        basic_aabb<T> bounds, centroid_bounds;
+        for (int i = begin; i < end; i++) {
+            bounds = basic_aabb<T>(bounds, boxes[order[i]]);
+            centroid_bounds = basic_aabb<T>(centroid_bounds, basic_aabb<T>(centroids[order[i]], centroids[order[i]]));
+        }
+
+        int count = end - begin;
+        nodes[node_index].bbox = bounds;
+
+        // Out of spare levels: a heuristic split could leave one side almost as large as this
+        // range, so end it in a leaf if it fits in one, or else halve it at the median centroid
+        // of its widest axis, which always fits.
+        if (depth + median_levels(count) >= bvh_max_depth) {
+            if (count <= max_leaf_size) {
+                nodes[node_index].offset = begin;
+                nodes[node_index].count = count;
+                return node_index;
+            }
+            int axis = 0;
+            for (int a = 1; a < 3; a++) {
+                if (centroid_bounds.axis(a).size() > centroid_bounds.axis(axis).size())
+                    axis = a;
+            }
+            int mid = begin + count / 2;
+            std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+                return centroids[a][axis] < centroids[b][axis];
+            });
+            return make_interior(boxes, centroids, nodes, order, node_index, begin, mid, end, axis, packet_width, depth);
+        }
+
+        auto packets = [packet_width](int n) { return static_cast<double>((n + packet_width - 1) / packet_width); };
+
+        // Find the cheapest bin boundary over all three axes.
+        int best_axis = -1, best_split = 0;
+        double best_cost = infinity;
+        if (count > 1) {
+            for (int axis = 0; axis < 3; axis++) {
+                const basic_interval<T>& extent = centroid_bounds.axis(axis);
+                if (extent.size() <= 0)
+                    continue;
+
+                bin bins[bin_count];
+                auto scale = bin_count / static_cast<double>(extent.size());
+                for (int i = begin; i < end; i++) {
+                    auto& b = bins[bin_index(centroids[order[i]][axis], extent.min, scale)];
+                    b.bbox = basic_aabb<T>(b.bbox, boxes[order[i]]);
+                    b.count++;
+                }
+
+                // Sweep from the right to get the cost of every right-hand side, then from the left.
+                double right_area[bin_count];
+                int right_count[bin_count];
+                basic_aabb<T> right_box;
+                int right_total = 0;
+                for (int b = bin_count - 1; b > 0; b--) {
+                    right_box = basic_aabb<T>(right_box, bins[b].bbox);
+                    right_total += bins[b].count;
+                    right_area[b] = right_box.surface_area();
+                    right_count[b] = right_total;
+                }
+
+                basic_aabb<T> left_box;
+                int left_total = 0;
+                for (int b = 0; b < bin_count - 1; b++) {
+                    left_box = basic_aabb<T>(left_box, bins[b].bbox);
+                    left_total += bins[b].count;
+                    if (left_total == 0 || right_count[b + 1] == 0)
+                        continue;
+
+                    double cost = static_cast<double>(left_box.surface_area()) * packets(left_total) + right_area[b + 1] * packets(right_count[b + 1]);
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = b + 1;
+                    }
+                }
+            }
+        }
+
+        // Compare against intersecting every primitive here (traversal cost of one box test).
+        double parent_area = bounds.surface_area();
+        auto leaf_cost = packets(count);
+        auto split_cost = parent_area > 0 ? 1.0 + best_cost / parent_area : infinity;
+
+        if (best_axis < 0 || (split_cost >= leaf_cost && count <= max_leaf_size)) {
+            if (best_axis < 0 && count > max_leaf_size) {
+                // All centroids coincide; fall back to splitting the range in half.
+                return make_interior(boxes, centroids, nodes, order, node_index, begin, begin + count / 2, end, 0, packet_width, depth);
+            }
+            nodes[node_index].offset = begin;
+            nodes[node_index].count = count;
+            return node_index;
+        }
+
+        const basic_interval<T>& extent = centroid_bounds.axis(best_axis);
+        auto scale = bin_count / static_cast<double>(extent.size());
+        auto mid = std::partition(order.begin() + begin, order.begin() + end, [&](int prim) {
+            return bin_index(centroids[prim][best_axis], extent.min, scale) < best_split;
+        });
+
+        return make_interior(boxes, centroids, nodes, order, node_index, begin,
+            static_cast<int>(mid - order.begin()), end, best_axis, packet_width, depth);
+    }
+
+    static int make_interior(const std::vector<basic_aabb<T>>& boxes, const std::vector<basic_point3<T>>& centroids,
+        std::vector<basic_bvh_flat_node<T>>& nodes, std::vector<int>& order, int node_index, int begin, int mid, int end, int axis,
+        int packet_width, int depth)
+    {
+        build_recursive(boxes, centroids, nodes, order, begin, mid, packet_width, depth + 1);
+        int second = build_recursive(boxes, centroids, nodes, order, mid, end, packet_width, depth + 1);
+
+        nodes[node_index].offset = second;
+        nodes[node_index].count = 0;
+        nodes[node_index].split_axis = axis;
+        return node_index;
+    }
+
+    static int bin_index(T centroid, T min, double scale) {
+        int b = static_cast<int>((centroid - min) * scale);
+        return b < 0 ? 0 : (b >= bin_count ? bin_count - 1 : b);
+    }
+};
+
+template <typename T>
+class basic_bvh_node : public basic_hittable<T> {
+public:
+    basic_bvh_node(const basic_hittable_list<T>& list) : basic_bvh_node(list.objects) {}
+
+    basic_bvh_node(const std::vector<shared_ptr<basic_hittable<T>>>& src_objects) {
+        std::vector<basic_aabb<T>> boxes;
+        boxes.reserve(src_objects.size());
+        for (const auto& object : src_objects)
+            boxes.push_back(object->bounding_box());
+
+        std::vector<int> order;
+        basic_bvh_builder<T>::build(boxes, nodes, order);
+        built_nodes = nodes;
+
+        // Store primitives in leaf order so each leaf is a contiguous run.
+        objects.reserve(order.size());
+        for (int index : order)
+            objects.push_back(src_objects[index]);
+    }
+
+    bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+        if (nodes.empty())
+            return false;
+
+        auto dir = r.direction();
+        basic_vec3<T> inv_dir(1 / dir.x(), 1 / dir.y(), 1 / dir.z());
+        bool dir_negative[3] = { dir.x() < 0, dir.y() < 0, dir.z() < 0 };
+
+        bool hit_anything = false;
+        int stack[bvh_max_depth];
+        int stack_size = 0;
+        int current = 0;
+
+        while (true) {
+            const basic_bvh_flat_node<T>& node = nodes[current];
+            if (node.bbox.hit(r, inv_dir, ray_t)) {
+                if (node.count > 0) {
+                    // Primitives only write `rec` when they report a hit, so no temporary is needed.
+                    for (int i = node.offset; i < node.offset + node.count; i++) {
+                        if (objects[i]->hit(r, ray_t, rec)) {
+                            hit_anything = true;
+                            ray_t.max = rec.t;
+                        }
+                    }
+                }
+                else {
+                    // Visit the child nearer along the split axis first.
+                    if (dir_negative[node.split_axis]) {
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }
+                    else {
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+                break;
+            current = stack[--stack_size];
+        }
+
+        return hit_anything;
+    }
+
+    const std::vector<basic_bvh_flat_node<T>>& bvh_nodes() const { return nodes; }
+
+    basic_aabb<T> bounding_box() const override {
+        return nodes.empty() ? basic_aabb<T>() : nodes[0].bbox;
+    }
+
+    void add_lights(basic_light_list<T>& lights) const override {
+        for (const auto& object : objects)
+            object->add_lights(lights);
+    }
+
+    // Updates the boxes after objects have moved, without rebuilding; see basic_bvh_builder::refit().
+    void refit() {
+        basic_bvh_builder<T>::refit(nodes, [this](int offset, int count) {
+            basic_aabb<T> box;
+            for (int i = offset; i < offset + count; i++)
+                box = basic_aabb<T>(box, objects[i]->bounding_box());
+            return box;
+        });
+    }
+
+    // Growth of the tree through refits since it was built; see basic_bvh_builder::growth().
+    double growth() const { return basic_bvh_builder<T>::growth(nodes, built_nodes); }
+
+private:
+    std::vector<basic_bvh_flat_node<T>> nodes;
+    std::vector<basic_bvh_flat_node<T>> built_nodes;  // The nodes as built, before any refit
+    std::vector<shared_ptr<basic_hittable<T>>> objects;
+};
+
+using bvh_flat_node = basic_bvh_flat_node<double>;
+using bvh_builder = basic_bvh_builder<double>;
+using bvh_node = basic_bvh_node<double>;
+
+#endif
@@ -0,0 +1,46 @@
+#include "RTWeekend.h"
+
+#include "BvhDepthCheck.h"
+#include "PrecisionBenchmark.h"
+#include "RenderBenchmark.h"
+#include "SphereKernelBenchmark.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+int main(int argc, char* argv[]) {
+    const char* mode = argc > 1 ? argv[1] : "spheres";
+
+    if (strcmp(mode, "spheres") == 0) {
+        run_sphere_kernel_benchmark<float>("float");
+        run_sphere_kernel_benchmark<double>("double");
+        return 0;
+    }
+
+    if (strcmp(mode, "depth") == 0)
+        return run_bvh_depth_check(argc > 2 ? atoi(argv[2]) : 1000);
+
+    if (strcmp(mode, "precision") == 0)
+        return run_precision_benchmark(argc > 2 ? atoi(argv[2]) : 400);
+
+    // "wavefront" renders the same scenes as "render", once path by path and twice a bounce at
+    // a time, without and with ray sorting.
+    bool wavefront = strcmp(mode, "wavefront") == 0;
+    if (strcmp(mode, "render") == 0 || wavefront) {
+        int width = argc > 2 ? atoi(argv[2]) : 400;
+        int samples_per_pixel = argc > 3 ? atoi(argv[3]) : 16;
+        int threads = argc > 4 ? atoi(argv[4]) : 0;
+        if (threads <= 0)
+            threads = static_cast<int>(std::thread::hardware_concurrency());
+        std::vector<render_tracer> tracers = { render_tracer::megakernel };
+        if (wavefront)
+            tracers = { render_tracer::megakernel, render_tracer::wavefront, render_tracer::wavefront_sorted };
+        return run_render_benchmark(width, samples_per_pixel, threads > 0 ? threads : 1, tracers);
+    }
+
+    std::cerr << "Unknown benchmark '" << mode << "'. Available: spheres, depth [count], precision [width], "
+        "render [width] [spp] [threads], wavefront [width] [spp] [threads]\n";
+    return 1;
+}
@@ -0,0 +1,84 @@
+#ifndef BVH_DEPTH_CHECK_H
+#define BVH_DEPTH_CHECK_H
+
+#include "rtweekend.h"
+
+#include "BVH.h"
+#include "color.h"
+#include "HittableList.h"
+#include "material.h"
+#include "sphere.h"
+#include "SphereSet.h"
+#include "TriangleMesh.h"
+
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+// Builds each kind of BVH over a row of primitives at x = 1.2^i, each a fifth of the gap to the
+// next in size. The surface area heuristic peels them off one at a time, so unbounded it would
+// build a tree as deep as there are primitives. Checks that every tree stays within
+// bvh_max_depth and that rays along the row, whose traversal descends the deepest path, still
+// find the next primitive. Returns nonzero on failure. Past about 1300 primitives the products
+// in the intersection tests overflow double, so the count should stay below that.
+inline int run_bvh_depth_check(int count) {
+    basic_material_table<double> materials;
+    auto mat = materials.add(basic_lambertian<double>(color(0.5, 0.5, 0.5)));
+
+    std::vector<double> positions(count), sizes(count);
+    hittable_list list;
+    std::vector<basic_sphere_params<double>> spheres;
+    basic_mesh_data<double> triangles;
+    for (int i = 0; i < count; i++) {
+        positions[i] = pow(1.2, i);
+        sizes[i] = 0.05 * positions[i];
+        point3 center(positions[i], 0, 0);
+        list.add(make_shared<sphere>(center, sizes[i], mat));
+        spheres.push_back({ center, sizes[i], mat });
+
+        // A triangle facing along the row, around its axis.
+        auto first = static_cast<uint32_t>(triangles.positions.size());
+        triangles.positions.push_back(point3(positions[i], -sizes[i], -sizes[i]));
+        triangles.positions.push_back(point3(positions[i], sizes[i], -sizes[i]));
+        triangles.positions.push_back(point3(positions[i], 0, 2 * sizes[i]));
+        triangles.indices.insert(triangles.indices.end(), { first, first + 1, first + 2 });
+    }
+
+    bvh_node sphere_tree(list);
+    basic_sphere_bvh<double> sphere_packets(spheres);
+    basic_triangle_mesh<double> mesh(triangles, mat);
+
+    struct tree { const char* name; const hittable& world; int depth; double radius_scale; };
+    const tree trees[] = {
+        { "bvh_node of spheres", sphere_tree, bvh_builder::depth(sphere_tree.bvh_nodes()), 1 },
+        { "sphere_bvh", sphere_packets, bvh_builder::depth(sphere_packets.packed().nodes), 1 },
+        { "triangle_mesh", mesh, bvh_builder::depth(mesh.bvh_nodes()), 0 },
+    };
+
+    int failures = 0;
+    printf("%d primitives, depth limit %d\ntree                  depth  misses\n", count, bvh_max_depth);
+    for (const auto& t : trees) {
+        // From the middle of each gap, forwards to the next primitive and back to the previous.
+        int misses = 0;
+        for (int i = 0; i + 1 < count; i++) {
+            double start = (positions[i] + positions[i + 1]) / 2;
+            double ahead = positions[i + 1] - t.radius_scale * sizes[i + 1] - start;
+            double behind = start - positions[i] - t.radius_scale * sizes[i];
+
+            hit_record rec;
+            if (!t.world.hit(ray(point3(start, 0, 0), vec3(1, 0, 0)), interval(0, infinity), rec) || fabs(rec.t - ahead) > 1e-9 * ahead)
+                misses++;
+            if (!t.world.hit(ray(point3(start, 0, 0), vec3(-1, 0, 0)), interval(0, infinity), rec) || fabs(rec.t - behind) > 1e-9 * behind)
+                misses++;
+        }
+
+        printf("%-20s  %5d  %6d\n", t.name, t.depth, misses);
+        if (t.depth > bvh_max_depth || misses > 0)
+            failures++;
+    }
+
+    printf(failures == 0 ? "passed\n" : "FAILED\n");
+    return failures == 0 ? 0 : 1;
+}
+
+#endif
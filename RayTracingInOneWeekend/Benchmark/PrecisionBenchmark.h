@@ -0,0 +1,74 @@
+#ifndef PRECISION_BENCHMARK_H
+#define PRECISION_BENCHMARK_H
+
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "Scenes.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Renders the Main.cpp scene once in float and once in double, then reports the speed of each
+// and how far the two 8-bit images are apart. Also writes image_diff.png (difference x8).
+template <typename T>
+double render_random_spheres(int image_width, const char* path) {
+    seed_random(0);
+    basic_material_table<T> materials;
+    auto world = random_spheres_scene<T>(materials);
+
+    basic_camera<T> cam;
+    random_spheres_camera(cam);
+    cam.image_width = image_width;
+    cam.output_path = path;
+
+    auto start = std::chrono::steady_clock::now();
+    cam.render(world, materials);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+inline int run_precision_benchmark(int image_width) {
+    double float_seconds = render_random_spheres<float>(image_width, "image_float.png");
+    double double_seconds = render_random_spheres<double>(image_width, "image_double.png");
+
+    int w, h, n, w2, h2, n2;
+    unsigned char* a = stbi_load("image_float.png", &w, &h, &n, 3);
+    unsigned char* b = stbi_load("image_double.png", &w2, &h2, &n2, 3);
+    if (a == NULL || b == NULL || w != w2 || h != h2) {
+        printf("Could not read back the rendered images\n");
+        return 1;
+    }
+
+    size_t count = static_cast<size_t>(w) * h * 3;
+    std::vector<unsigned char> diff(count);
+    double sum_sq = 0, sum_abs = 0;
+    int max_diff = 0;
+    size_t pixels_over = 0;
+    for (size_t i = 0; i < count; i += 3) {
+        int pixel_max = 0;
+        for (int c = 0; c < 3; c++) {
+            int d = abs(static_cast<int>(a[i + c]) - static_cast<int>(b[i + c]));
+            sum_sq += d * d;
+            sum_abs += d;
+            pixel_max = d > pixel_max ? d : pixel_max;
+            diff[i + c] = static_cast<unsigned char>(d * 8 > 255 ? 255 : d * 8);
+        }
+        max_diff = pixel_max > max_diff ? pixel_max : max_diff;
+        if (pixel_max > 8) pixels_over++;
+    }
+    stbi_write_png("image_diff.png", w, h, 3, diff.data(), w * 3);
+    stbi_image_free(a);
+    stbi_image_free(b);
+
+    double rmse = sqrt(sum_sq / count);
+    double psnr = rmse > 0 ? 20 * log10(255.0 / rmse) : infinity;
+    printf("width %d: float %.2fs, double %.2fs, float speedup %.2fx\n",
+        image_width, float_seconds, double_seconds, double_seconds / float_seconds);
+    printf("difference: mean %.3f, rmse %.3f, max %d, psnr %.2f dB, pixels off by >8: %.3f%%\n",
+        sum_abs / count, rmse, max_diff, psnr, 100.0 * pixels_over / (count / 3));
+    return 0;
+}
+
+#endif
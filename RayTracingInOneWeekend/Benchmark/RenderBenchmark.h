@@ -0,0 +1,197 @@
+#ifndef RENDER_BENCHMARK_H
+#define RENDER_BENCHMARK_H
+
+#include "rtweekend.h"
+
+#include "BVH.h"
+#include "camera.h"
+#include "Scenes.h"
+#include "TriangleMesh.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// Highest resident memory of the process so far, in MiB. It never goes down, so later scenes
+// report the peak over everything rendered before them too.
+inline double peak_memory_mb() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0;            // KiB
+#endif
+#endif
+}
+
+// How the camera follows its paths: each to the end in turn (trace_path()), or a bounce of all
+// of a tile's paths at a time, with or without sorting the rays between stages.
+enum class render_tracer { megakernel, wavefront, wavefront_sorted };
+
+inline const char* render_tracer_name(render_tracer tracer) {
+    switch (tracer) {
+    case render_tracer::wavefront:        return "wavefront";
+    case render_tracer::wavefront_sorted: return "wavefront_sorted";
+    default:                              return "megakernel";
+    }
+}
+
+struct render_benchmark_result {
+    std::string  name;
+    std::string  tracer;
+    int          width = 0;
+    int          samples_per_pixel = 0;
+    int          max_depth = 0;
+    size_t       primitives = 0;
+    double       bvh_build_ms = 0;
+    render_stats stats;
+    double       peak_memory_mb = 0;
+};
+
+// Builds one scene from a fixed seed, timing only the acceleration structures, then renders it
+// once with each of `tracers`, appending a result per render. `build` fills the material table,
+// returns the unaccelerated geometry and reports its primitive count; `accelerate` turns that
+// geometry into the world that gets rendered.
+template <typename T, typename Build, typename Accelerate, typename SetupCamera>
+void run_render_scene(const char* name, int width, int samples_per_pixel, int threads,
+    const std::vector<render_tracer>& tracers, std::vector<render_benchmark_result>& results,
+    Build build, Accelerate accelerate, SetupCamera setup_camera)
+{
+    render_benchmark_result result;
+    result.name = name;
+
+    seed_random(1);
+    basic_material_table<T> materials;
+    auto geometry = build(materials, result.primitives);
+
+    auto start = std::chrono::steady_clock::now();
+    basic_hittable_list<T> world = accelerate(geometry);
+    std::chrono::duration<double, std::milli> build_time = std::chrono::steady_clock::now() - start;
+    result.bvh_build_ms = build_time.count();
+
+    for (render_tracer tracer : tracers) {
+        basic_camera<T> cam;
+        setup_camera(cam);
+        cam.image_width = width;
+        cam.samples_per_pixel = samples_per_pixel;
+        cam.thread_count = threads;
+        cam.seed = 0;
+        cam.output_path = std::string("bench_") + name + ".png";
+        cam.wavefront = tracer != render_tracer::megakernel;
+        cam.sort_rays = tracer == render_tracer::wavefront_sorted;
+
+        result.tracer = render_tracer_name(tracer);
+        std::clog << "Rendering " << name << " (" << result.tracer << ")...\n";
+        cam.render(world, materials);
+
+        result.width = width;
+        result.samples_per_pixel = samples_per_pixel;
+        result.max_depth = cam.max_depth;
+        result.stats = cam.stats;
+        result.peak_memory_mb = peak_memory_mb();
+        results.push_back(result);
+    }
+}
+
+inline void print_render_benchmark_json(const std::vector<render_benchmark_result>& results, int threads) {
+    printf("{\n  \"benchmark\": \"render\",\n  \"precision\": \"double\",\n  \"threads\": %d,\n  \"scenes\": [\n", threads);
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        double seconds = r.stats.seconds > 0 ? r.stats.seconds : 1;
+        printf("    {\n");
+        printf("      \"name\": \"%s\",\n", r.name.c_str());
+        printf("      \"tracer\": \"%s\",\n", r.tracer.c_str());
+        printf("      \"width\": %d,\n", r.width);
+        printf("      \"samples_per_pixel\": %d,\n", r.samples_per_pixel);
+        printf("      \"max_depth\": %d,\n", r.max_depth);
+        printf("      \"primitives\": %zu,\n", r.primitives);
+        printf("      \"bvh_build_ms\": %.3f,\n", r.bvh_build_ms);
+        printf("      \"render_seconds\": %.3f,\n", r.stats.seconds);
+        printf("      \"primary_rays\": %llu,\n", static_cast<unsigned long long>(r.stats.primary_rays));
+        printf("      \"secondary_rays\": %llu,\n", static_cast<unsigned long long>(r.stats.secondary_rays));
+        printf("      \"primary_rays_per_sec\": %.0f,\n", r.stats.primary_rays / seconds);
+        printf("      \"secondary_rays_per_sec\": %.0f,\n", r.stats.secondary_rays / seconds);
+        printf("      \"rays_per_sec\": %.0f,\n", (r.stats.primary_rays + r.stats.secondary_rays) / seconds);
+        printf("      \"peak_memory_mb\": %.1f\n", r.peak_memory_mb);
+        printf("    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+// Renders the fixed benchmark scenes (Main.cpp's random spheres, a dense sphere grid and a
+// triangle-heavy scene) with each of `tracers` and prints the results as JSON on stdout.
+// Progress goes to std::clog.
+inline int run_render_benchmark(int width, int samples_per_pixel, int threads,
+    const std::vector<render_tracer>& tracers = { render_tracer::megakernel })
+{
+    using T = double;
+    using list = basic_hittable_list<T>;
+    auto accelerate_list = [](const list& objects) {
+        return list(make_shared<basic_bvh_node<T>>(objects));
+    };
+
+    std::vector<render_benchmark_result> results;
+
+    run_render_scene<T>("random_spheres", width, samples_per_pixel, threads, tracers, results,
+        [](basic_material_table<T>& materials, size_t& primitives) {
+            auto objects = random_spheres_objects(materials);
+            primitives = objects.objects.size();
+            return objects;
+        },
+        accelerate_list, random_spheres_camera<T>);
+
+    run_render_scene<T>("sphere_grid", width, samples_per_pixel, threads, tracers, results,
+        [](basic_material_table<T>& materials, size_t& primitives) {
+            auto objects = sphere_grid_objects(materials, 100);
+            primitives = objects.objects.size();
+            return objects;
+        },
+        accelerate_list, sphere_grid_camera<T>);
+
+    // The triangle meshes build their own BVHs, so their construction is part of the timing.
+    struct mesh_set {
+        std::vector<basic_mesh_data<T>> meshes;
+        std::vector<material_id> materials;
+    };
+    run_render_scene<T>("triangles", width, samples_per_pixel, threads, tracers, results,
+        [](basic_material_table<T>& materials, size_t& primitives) {
+            mesh_set set;
+            set.meshes = triangle_scene_meshes(materials, set.materials);
+            primitives = 0;
+            for (const auto& mesh : set.meshes)
+                primitives += mesh.triangle_count();
+            return set;
+        },
+        [](const mesh_set& set) {
+            list objects;
+            for (size_t i = 0; i < set.meshes.size(); i++)
+                objects.add(make_shared<basic_triangle_mesh<T>>(set.meshes[i], set.materials[i]));
+            return list(make_shared<basic_bvh_node<T>>(objects));
+        },
+        triangle_camera<T>);
+
+    print_render_benchmark_json(results, threads);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SPHERE_KERNEL_BENCHMARK_H
+#define SPHERE_KERNEL_BENCHMARK_H
+
+#include "rtweekend.h"
+
+#include "color.h"
+#include "HittableList.h"
+#include "material.h"
+#include "sphere.h"
+#include "SphereSet.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Times one ray against N spheres through the virtual sphere::hit path and the packet path.
+template <typename T>
+void run_sphere_kernel_benchmark(const char* precision) {
+    const int ray_count = 1 << 18;
+    const int sphere_counts[] = { 8, 32, 128, 512, 2048 };
+
+    seed_random(1);
+    std::vector<basic_ray<T>> rays;
+    rays.reserve(ray_count);
+    for (int i = 0; i < ray_count; i++)
+        rays.push_back(basic_ray<T>(basic_point3<T>::random(-1, 1), random_unit_vector<T>()));
+
+    basic_material_table<T> materials;
+    auto mat = materials.add(basic_lambertian<T>(basic_color<T>(T(0.5), T(0.5), T(0.5))));
+
+    std::cout << precision << "\nspheres  lanes  list Mrays/s  packet Mrays/s  speedup  mismatches\n";
+    for (int sphere_count : sphere_counts) {
+        basic_hittable_list<T> list;
+        basic_sphere_set<T> packet;
+        for (int i = 0; i < sphere_count; i++) {
+            auto center = basic_point3<T>::random(-20, 20);
+            auto radius = random_real<T>(T(0.1), T(1.0));
+            list.add(make_shared<basic_sphere<T>>(center, radius, mat));
+            packet.add(center, radius, mat);
+        }
+
+        // Fewer rays for bigger sets keeps each run around the same length.
+        int rays_to_trace = ray_count * 8 / sphere_count;
+        if (rays_to_trace > ray_count) rays_to_trace = ray_count;
+
+        std::vector<T> list_t(rays_to_trace), packet_t(rays_to_trace);
+        auto time_path = [&](const basic_hittable<T>& world, std::vector<T>& hits) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < rays_to_trace; i++) {
+                basic_hit_record<T> rec;
+                hits[i] = world.hit(rays[i], basic_interval<T>(T(0.001), std::numeric_limits<T>::infinity()), rec) ? rec.t : -1;
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return rays_to_trace / elapsed.count() / 1e6;
+        };
+
+        double list_rate = time_path(list, list_t);
+        double packet_rate = time_path(packet, packet_t);
+
+        int mismatches = 0;
+        for (int i = 0; i < rays_to_trace; i++)
+            if (fabs(list_t[i] - packet_t[i]) > 1e-4 * fabs(list_t[i]))
+                mismatches++;
+
+        printf("%7d  %5d  %13.2f  %14.2f  %6.2fx  %10d\n",
+            sphere_count, basic_sphere_set<T>::lane_count, list_rate, packet_rate, packet_rate / list_rate, mismatches);
+    }
+}
+
+#endif
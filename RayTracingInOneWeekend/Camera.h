@@ -1,72 +1,211 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
-
 #include "rtweekend.h"
 
 #include "color.h"
 #include "hittable.h"
 #include "material.h"
-
+#include "Denoiser.h"
+#include "ImageOutput.h"
+#include "Lights.h"
+#include "Region.h"
+#include "Sampler.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Counters filled in by camera::render().
+struct render_stats {
+    uint64_t primary_rays = 0;    // Rays leaving the camera, one per sample
+    uint64_t secondary_rays = 0;  // Scattered and shadow rays traced after a surface hit
+    double   seconds = 0;         // Wall-clock time of the whole render
+};
 
-class camera {
+template <typename T>
+class basic_camera {
 public:
-    double aspect_ratio = 1.0;      // Ratio of image width over height
+    // Scalar-typed names for the rest of the class, so a whole render can run in float.
+    using vec3 = basic_vec3<T>;
+    using point3 = basic_point3<T>;
+    using color = basic_color<T>;
+    using ray = basic_ray<T>;
+    using interval = basic_interval<T>;
+    using hittable = basic_hittable<T>;
+    using hit_record = basic_hit_record<T>;
+    using material_table = basic_material_table<T>;
+
+    T      aspect_ratio = 1;        // Ratio of image width over height
     int    image_width = 100;       // Rendered image width in pixel count
     int    samples_per_pixel = 10;  // Count of random samples for each pixel
     int    max_depth = 10;          // Maximum number of ray bounces into scene
+    int    rr_start_depth = 3;      // Bounces before Russian roulette may end a path
 
-    double vfov = 90;                   // Vertical view angle (field of view)
+    T      vfov = 90;                   // Vertical view angle (field of view)
     point3 lookfrom = point3(0, 0, -1); // Point camera is looking from
     point3 lookat = point3(0, 0, 0);    // Point camera is looking at
     vec3   vup = vec3(0, 1, 0);         // Camera-relative "up" direction
 
-    double defocus_angle = 0;  // Variation angle of rays through each pixel
-    double focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
+    T      defocus_angle = 0;  // Variation angle of rays through each pixel
+    T      focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
+
+    bool   sky = true;         // Light the scene with the book's sky gradient
+    color  background;         // Radiance of rays that leave the scene when sky is off
+
+    // Next-event estimation: at every diffuse hit, also sample a point on one of the scene's
+    // emitters (collected by add_lights()) and trace a shadow ray to it. Light found that way and
+    // light found by scattering into an emitter are combined with multiple importance sampling,
+    // so small lights no longer depend on a random bounce happening to find them.
+    bool   next_event = true;
+
+    int    thread_count = 0;        // Render threads (0 = one per hardware thread)
+    int    tile_size = 32;          // Width and height of a square render tile in pixels
+    uint64_t seed = 0;              // Base seed; equal seeds give identical images for any thread count
+    sampler_type sampling = sampler_type::independent; // Placement of pixel, lens and scattering samples (see Sampler.h)
+    std::string output_path = "image.png"; // Finished image; .png, .ppm (8-bit) or .hdr (linear float)
+    bool   stream_tiles = false;    // Write each finished row of tiles straight to disk (.ppm or .hdr only)
+
+    // Progressive mode renders in passes and stops sampling a pixel once its estimated error is
+    // low enough; samples_per_pixel then becomes the per-pixel cap.
+    bool   adaptive = false;
+    int    min_samples = 32;           // Samples every pixel gets before its error is trusted
+    int    pass_samples = 16;          // Samples added to each unconverged pixel per pass
+    T      error_threshold = T(0.01);  // Target standard error of a pixel's gamma-corrected luminance
+    double time_budget = 0;            // Wall-clock limit in seconds, checked between passes (0 = none)
+
+    // Checkpointing saves the accumulation between passes, and a render that finds a matching
+    // checkpoint at its path carries on from it. The sample cap, error threshold and time budget
+    // may differ from the run that wrote it, so a finished render can be resumed to converge
+    // further. Needs the whole image in memory, so it cannot be combined with stream_tiles.
+    std::string checkpoint_path;       // Checkpoint file ("" = no checkpoints)
+    double checkpoint_interval = 600;  // Minimum seconds between checkpoints; one is always written at the end
+
+    // With region_count > 1 only the tile rows of region region_index are rendered (see
+    // Region.h), and output_path receives a region buffer for merge_regions() instead of an
+    // image; "-" writes it to stdout.
+    int    region_index = 0;
+    int    region_count = 1;
+
+    // Wavefront mode traces a tile's samples one bounce at a time: all their rays are
+    // intersected, then all hits shaded, then the survivors compacted for the next bounce, instead
+    // of following each path to the end before starting the next. Every path keeps its own random
+    // stream, so the image is identical to the path-at-a-time render.
+    bool   wavefront = false;
+    bool   sort_rays = false;        // Group rays by direction octant before intersection and hits by material before shading
+    int    wavefront_paths = 16384;  // Paths in flight per tile; a tile with more samples runs several waves
+
+    // Denoising filters the finished image, guided by the albedo and normal of the first surface
+    // each pixel sees (see Denoiser.h), so a few samples per pixel give a clean picture. Needs the
+    // whole image in memory, so it cannot be combined with stream_tiles or regions.
+    bool   denoise = false;
+    denoiser denoise_filter;        // Passes and edge-stopping strengths of the filter
+
+    render_stats stats;                // Ray counts and timing of the last render
+
+    void render(const hittable& world, const material_table& materials) {
+        thread_pool pool(thread_count);
+        render(world, materials, pool);
+    }
 
-    void render(const hittable& world) {
+    // Renders with the threads of `pool` rather than ones of its own, so a sequence of frames can
+    // share them. The buffers from the previous render are reused as well.
+    void render(const hittable& world, const material_table& materials, thread_pool& pool) {
         initialize();
-        int channel_count = 3;
-        int pixel_count = image_width * image_height;
-        int pixel_element_count = pixel_count * channel_count;
-        size_t img_size = pixel_element_count * sizeof(unsigned char); //uint8_t
-        auto img = (unsigned char*)malloc(img_size);
-        if (img == NULL) {
-            printf("Error in loading the image\n");
-            exit(1);
-        }
-
-        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+        lights.build(world, materials);
+        if (next_event && !lights.empty())
+            std::clog << "Sampling " << lights.size() << " lights\n";
 
-        for (int j = 0; j < image_height; ++j) {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
-            for (int i = 0; i < image_width; ++i) {
-                color pixel_color(0, 0, 0);
-                for (int sample = 0; sample < samples_per_pixel; ++sample) {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, world);
-                }
+        if (stream_tiles && !image_output::can_stream(output_path)) {
+            std::cerr << "Streaming tiles needs a .hdr or .ppm output path, not '" << output_path << "'\n";
+            return;
+        }
+        if (region_count < 1 || region_index < 0 || region_index >= region_count) {
+            std::cerr << "Region " << region_index << " of " << region_count << " does not exist\n";
+            return;
+        }
+        bool whole_image = !stream_tiles && region_count == 1;
+        if (!whole_image && !checkpoint_path.empty()) {
+            std::cerr << "Checkpoints need the whole image in memory; turn off stream_tiles and regions\n";
+            return;
+        }
+        if (!whole_image && denoise) {
+            std::cerr << "The denoiser needs the whole image in memory; turn off stream_tiles and regions\n";
+            return;
+        }
 
-                //write_color(std::cout, pixel_color, samples_per_pixel); // can spit data into a file like PPM (program_name.exe > image_name.ppm)
-                pixel_color = normal_to_color_space(pixel_color, samples_per_pixel);
-                *img = pixel_color.x();
-                img ++;
-                *img = pixel_color.y();
-                img++;
-                *img = pixel_color.z();
-                img++;
+        stats = render_stats();
+        bool resumed = false;
+        if (!checkpoint_path.empty() && !load_checkpoint(world, materials, resumed))
+            return;
+
+        region_buffer region;
+        region.width = image_width;
+        region.height = image_height;
+        region.tile_size = tile_size;
+        region.index = region_index;
+        region.count = region_count;
+
+        image_output output;
+        if (region_count == 1 && !output.open(output_path, image_width, image_height))
+            return;
+
+        auto start = std::chrono::steady_clock::now();
+
+        // The image is rendered in horizontal bands, each resolved to linear float RGB and
+        // handed to the writer once done. Without streaming or regions the whole image is one band.
+        int band_height = whole_image ? image_height : tile_size;
+        long long total_samples = 0;
+        long long total_pixels = 0;
+        for (int band_y = 0; band_y < image_height; band_y += band_height) {
+            if (!region.owns_tile_row(band_y / tile_size))
+                continue;
+            int band_rows = std::min(band_height, image_height - band_y);
+            render_band(world, materials, pool, band_y, band_rows, start, resumed);
+
+            framebuffer.resize(static_cast<size_t>(band_rows) * image_width * 3);
+            for (size_t index = 0; index < pixels.size(); ++index) {
+                const pixel_state& state = pixels[index];
+                total_samples += state.count;
+
+                color mean = state.sum / static_cast<T>(state.count);
+                framebuffer[index * 3 + 0] = static_cast<float>(mean.x());
+                framebuffer[index * 3 + 1] = static_cast<float>(mean.y());
+                framebuffer[index * 3 + 2] = static_cast<float>(mean.z());
             }
+            total_pixels += static_cast<long long>(pixels.size());
+            if (denoise)
+                denoise_band(pool, framebuffer);
+
+            if (region_count > 1)
+                region.rgb.insert(region.rgb.end(), framebuffer.begin(), framebuffer.end());
+            else
+                output.write_rows(band_rows, framebuffer.data());
         }
 
-        img -= pixel_element_count; // Move pointer back to first element
-        stbi_write_png("image.png", image_width, image_height, channel_count, img, image_width * channel_count);
-        stbi_image_free(img);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        stats.seconds += elapsed.count();
+        if (region_count > 1) {
+            region.primary_rays = stats.primary_rays;
+            region.secondary_rays = stats.secondary_rays;
+            region.seconds = stats.seconds;
+            region.save(output_path);
+        }
+        else {
+            output.close();
+        }
 
+        if (adaptive)
+            std::clog << "Average samples per pixel: " << static_cast<double>(total_samples) / static_cast<double>(total_pixels) << '\n';
         std::clog << "\rDone.                 \n";
     }
 
@@ -79,6 +218,42 @@ private:
     vec3   u, v, w;        // Camera frame basis vectors
     vec3   defocus_disk_u; // Defocus disk horizontal radius
     vec3   defocus_disk_v; // Defocus disk vertical radius
+    T      pixel_spread;   // Angle the camera's ray cones widen by, per unit of distance
+
+    struct pixel_state {
+        color sum;         // Sum of all sample colors
+        color albedo_sum;  // Sums of the denoiser guides of all samples
+        vec3  normal_sum;
+        T     lum_sum = 0; // Sum and sum of squares of sample luminance, for the variance estimate
+        T     lum_sq_sum = 0;
+        int   count = 0;
+        bool  done = false;
+    };
+    std::vector<pixel_state> pixels; // Running accumulation of the current band, row-major
+    std::vector<float> framebuffer;  // The band resolved to linear RGB for output
+    int band_y = 0;                  // First image row held in `pixels`
+    int pass = 0;                    // Sampling passes completed over the band
+    int pass_target = 0;             // Samples per pixel the last completed pass aimed for
+    basic_light_list<T> lights;      // The world's emitters, for next-event estimation
+
+    // Checkpoint file layout: this header, then per pixel in row-major order the color sum, the
+    // two luminance sums, the albedo and normal sums (all as T) and the sample count as int32, in
+    // native byte order. The random state needs no space of its own: every sample reseeds from the
+    // seed, the pixel and the sample index, so the seed and the counts say exactly where each
+    // pixel's stream resumes.
+    struct checkpoint_header {
+        char     magic[8];       // "RTCKPT2" and a terminating zero
+        uint64_t seed;
+        uint64_t fingerprint;    // Hash of everything that changes what a given sample returns
+        uint64_t primary_rays;   // Render statistics so far, so the totals cover every run
+        uint64_t secondary_rays;
+        double   seconds;
+        int32_t  scalar_size;    // sizeof(T)
+        int32_t  width, height;
+        int32_t  pass, pass_target;
+        int32_t  reserved;
+    };
+    static const int checkpoint_pixel_size = 11 * sizeof(T) + sizeof(int32_t);
 
     void initialize() {
         image_height = static_cast<int>(image_width / aspect_ratio);
@@ -88,9 +263,9 @@ private:
 
         // Determine viewport dimensions.
         auto theta = degrees_to_radians(vfov);
-        auto h = tan(theta / 2);
+        auto h = std::tan(theta / 2);
         auto viewport_height = 2 * h * focus_dist;
-        auto viewport_width = viewport_height * (static_cast<double>(image_width) / image_height);
+        auto viewport_width = viewport_height * (static_cast<T>(image_width) / image_height);
 
         // Calculate the u,v,w unit basis vectors for the camera coordinate frame.
         w = unit_vector(lookfrom - lookat);
@@ -107,59 +282,601 @@ private:
 
         // Calculate the location of the upper left pixel.
         auto viewport_upper_left = center - (focus_dist * w) - viewport_u / 2 - viewport_v / 2;
-        pixel00_loc = viewport_upper_left + 0.5 * (pixel_delta_u + pixel_delta_v);
+        pixel00_loc = viewport_upper_left + T(0.5) * (pixel_delta_u + pixel_delta_v);
 
         // Calculate the camera defocus disk basis vectors.
-        auto defocus_radius = focus_dist * tan(degrees_to_radians(defocus_angle / 2));
+        auto defocus_radius = focus_dist * std::tan(degrees_to_radians(defocus_angle / 2));
         defocus_disk_u = u * defocus_radius;
         defocus_disk_v = v * defocus_radius;
+
+        // A camera ray's cone spans one pixel, narrowed as more samples per pixel antialias the
+        // texture between them (as pbrt-v4 does), down to an eighth of a pixel.
+        pixel_spread = 2 * h / image_height * std::max(T(0.125), 1 / sqrt(static_cast<T>(std::max(samples_per_pixel, 1))));
     }
 
-    ray get_ray(int i, int j) const {
+    void render_band(const hittable& world, const material_table& materials, thread_pool& pool, int y0, int rows,
+        std::chrono::steady_clock::time_point start, bool resumed)
+    {
+        // Runs all sampling passes over the image rows [y0, y0 + rows), which start on a tile
+        // boundary. `pixels` holds the band's accumulation afterwards. A resumed band keeps the
+        // pixels, pass and target restored from the checkpoint.
+        band_y = y0;
+        if (!resumed) {
+            pixels.assign(static_cast<size_t>(rows) * image_width, pixel_state());
+            pass = 0;
+            pass_target = 0;
+        }
+
+        int tiles_x = (image_width + tile_size - 1) / tile_size;
+        int tile_y0 = y0 / tile_size;
+        int tile_y1 = (y0 + rows + tile_size - 1) / tile_size;
+        std::mutex log_lock;
+
+        // With checkpoints a uniform render also goes in passes, so there is something to save
+        // along the way. Samples are summed in the same order either way, so the image is the same.
+        bool checkpointing = !checkpoint_path.empty();
+        int step = std::max(pass_samples, 1);
+        int first_target = adaptive ? std::max(min_samples, 1) : checkpointing ? step : samples_per_pixel;
+        auto last_checkpoint = std::chrono::steady_clock::now();
+
+        while (true) {
+            int target = std::min(pass_target == 0 ? first_target : pass_target + step, samples_per_pixel);
+            ++pass;
+            // Every sample seeds its own random stream, so the result does not depend on
+            // which thread renders which tile.
+            std::atomic<int> tiles_remaining(tiles_x * (tile_y1 - tile_y0));
+            std::atomic<int> active(0);
+            for (int ty = tile_y0; ty < tile_y1; ++ty) {
+                for (int tx = 0; tx < tiles_x; ++tx) {
+                    pool.submit([&, tx, ty] {
+                        render_stats tile_stats;
+                        active += render_tile(world, materials, tx, ty, target, tile_stats);
+
+                        int remaining = --tiles_remaining;
+                        std::lock_guard<std::mutex> guard(log_lock);
+                        stats.primary_rays += tile_stats.primary_rays;
+                        stats.secondary_rays += tile_stats.secondary_rays;
+                        if (rows < image_height)
+                            std::clog << "\rRows " << y0 << "-" << y0 + rows << " of " << image_height << ", ";
+                        else
+                            std::clog << "\r";
+                        std::clog << "Pass " << pass << ", tiles remaining: " << remaining << ' ' << std::flush;
+                    });
+                }
+            }
+            pool.wait();
+
+            pass_target = target;
+
+            if (adaptive)
+                std::clog << "\rPass " << pass << ": " << target << " spp max, " << active << " pixels unconverged      \n";
+
+            auto now = std::chrono::steady_clock::now();
+            std::chrono::duration<double> elapsed = now - start;
+            bool finished = active == 0 || target >= samples_per_pixel || (time_budget > 0 && elapsed.count() >= time_budget);
+
+            std::chrono::duration<double> since_checkpoint = now - last_checkpoint;
+            if (checkpointing && (finished || since_checkpoint.count() >= checkpoint_interval)) {
+                save_checkpoint(world, materials, stats.seconds + elapsed.count());
+                last_checkpoint = now;
+            }
+            if (finished)
+                break;
+        }
+    }
+
+    uint64_t checkpoint_fingerprint(const hittable& world, const material_table& materials) const {
+        // Camera placement, path settings and the rough shape of the scene. It cannot prove the
+        // scene is the same, but it catches resuming against the wrong setup or a changed view.
+        uint64_t h = hash_seed(static_cast<uint64_t>(image_width), static_cast<uint64_t>(image_height));
+        auto mix = [&h](double value) {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            h = hash_seed(h, bits);
+        };
+        auto box = world.bounding_box();
+        const T values[] = {
+            vfov, defocus_angle, focus_dist,
+            lookfrom.x(), lookfrom.y(), lookfrom.z(), lookat.x(), lookat.y(), lookat.z(), vup.x(), vup.y(), vup.z(),
+            box.x.min, box.x.max, box.y.min, box.y.max, box.z.min, box.z.max
+        };
+        for (T value : values)
+            mix(static_cast<double>(value));
+        mix(max_depth);
+        mix(rr_start_depth);
+        mix(sky ? 1 : 0);
+        mix(static_cast<double>(background.x()));
+        mix(static_cast<double>(background.y()));
+        mix(static_cast<double>(background.z()));
+        mix(next_event ? 1 : 0);
+        mix(static_cast<double>(sampling));
+        mix(static_cast<double>(materials.size()));
+        return h;
+    }
+
+    void save_checkpoint(const hittable& world, const material_table& materials, double seconds) const {
+        // Written to a temporary file that then replaces the old checkpoint, so a process killed
+        // mid-write leaves the previous checkpoint intact.
+        std::string temp_path = checkpoint_path + ".tmp";
+        FILE* file = fopen(temp_path.c_str(), "wb");
+        if (file == NULL) {
+            std::cerr << "Could not open '" << temp_path << "' for writing\n";
+            return;
+        }
+
+        checkpoint_header header = {};
+        memcpy(header.magic, "RTCKPT2", 8);
+        header.seed = seed;
+        header.fingerprint = checkpoint_fingerprint(world, materials);
+        header.primary_rays = stats.primary_rays;
+        header.secondary_rays = stats.secondary_rays;
+        header.seconds = seconds;
+        header.scalar_size = sizeof(T);
+        header.width = image_width;
+        header.height = image_height;
+        header.pass = pass;
+        header.pass_target = pass_target;
+        fwrite(&header, sizeof(header), 1, file);
+
+        std::vector<unsigned char> row(static_cast<size_t>(image_width) * checkpoint_pixel_size);
+        for (int j = 0; j < image_height; ++j) {
+            unsigned char* out = row.data();
+            for (int i = 0; i < image_width; ++i) {
+                const pixel_state& state = pixels[static_cast<size_t>(j) * image_width + i];
+                const T sums[11] = {
+                    state.sum.x(), state.sum.y(), state.sum.z(), state.lum_sum, state.lum_sq_sum,
+                    state.albedo_sum.x(), state.albedo_sum.y(), state.albedo_sum.z(),
+                    state.normal_sum.x(), state.normal_sum.y(), state.normal_sum.z()
+                };
+                int32_t count = state.count;
+                memcpy(out, sums, sizeof(sums));
+                memcpy(out + sizeof(sums), &count, sizeof(count));
+                out += checkpoint_pixel_size;
+            }
+            fwrite(row.data(), 1, row.size(), file);
+        }
+
+        bool ok = ferror(file) == 0;
+        ok = fclose(file) == 0 && ok;
+#if defined(_WIN32)
+        // rename() will not replace an existing file on Windows.
+        if (ok)
+            remove(checkpoint_path.c_str());
+#endif
+        if (!ok || rename(temp_path.c_str(), checkpoint_path.c_str()) != 0) {
+            std::cerr << "Failed to write checkpoint '" << checkpoint_path << "'\n";
+            remove(temp_path.c_str());
+        }
+    }
+
+    bool load_checkpoint(const hittable& world, const material_table& materials, bool& resumed) {
+        // Restores the pixels, passes and statistics of a checkpoint, if there is one. Returns
+        // false if a checkpoint exists but cannot be used, rather than overwrite it.
+        resumed = false;
+        FILE* file = fopen(checkpoint_path.c_str(), "rb");
+        if (file == NULL)
+            return true;
+
+        checkpoint_header header;
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "RTCKPT2", 8) == 0
+            && header.scalar_size == static_cast<int32_t>(sizeof(T));
+        if (!ok) {
+            std::cerr << "'" << checkpoint_path << "' is not a checkpoint of this renderer\n";
+            fclose(file);
+            return false;
+        }
+        if (header.width != image_width || header.height != image_height || header.seed != seed
+            || header.fingerprint != checkpoint_fingerprint(world, materials)) {
+            std::cerr << "Checkpoint '" << checkpoint_path << "' was made for a different scene, camera or seed; "
+                "delete it to start over\n";
+            fclose(file);
+            return false;
+        }
+
+        pixels.assign(static_cast<size_t>(image_width) * image_height, pixel_state());
+        std::vector<unsigned char> row(static_cast<size_t>(image_width) * checkpoint_pixel_size);
+        for (int j = 0; j < image_height && ok; ++j) {
+            ok = fread(row.data(), 1, row.size(), file) == row.size();
+            const unsigned char* in = row.data();
+            for (int i = 0; i < image_width && ok; ++i) {
+                pixel_state& state = pixels[static_cast<size_t>(j) * image_width + i];
+                T sums[11];
+                int32_t count;
+                memcpy(sums, in, sizeof(sums));
+                memcpy(&count, in + sizeof(sums), sizeof(count));
+                in += checkpoint_pixel_size;
+
+                state.sum = color(sums[0], sums[1], sums[2]);
+                state.lum_sum = sums[3];
+                state.lum_sq_sum = sums[4];
+                state.albedo_sum = color(sums[5], sums[6], sums[7]);
+                state.normal_sum = vec3(sums[8], sums[9], sums[10]);
+                state.count = count;
+                // Done-ness is decided again, since the sample cap or threshold may have changed.
+                state.done = count > 0 && (count >= samples_per_pixel || (adaptive && converged(state)));
+            }
+        }
+        fclose(file);
+        if (!ok) {
+            std::cerr << "Checkpoint '" << checkpoint_path << "' is truncated\n";
+            return false;
+        }
+
+        pass = header.pass;
+        pass_target = header.pass_target;
+        stats.primary_rays = header.primary_rays;
+        stats.secondary_rays = header.secondary_rays;
+        stats.seconds = header.seconds;
+        resumed = true;
+        std::clog << "Resuming from '" << checkpoint_path << "' after pass " << pass << " (" << pass_target << " spp)\n";
+        return true;
+    }
+
+    int render_tile(const hittable& world, const material_table& materials, int tx, int ty, int target, render_stats& tile_stats) {
+        // Brings every unfinished pixel of the tile up to `target` samples and returns how many
+        // of them still need more.
+        int x0 = tx * tile_size, x1 = std::min(x0 + tile_size, image_width);
+        int y0 = ty * tile_size, y1 = std::min(y0 + tile_size, image_height);
+        if (wavefront)
+            trace_tile_wavefront(world, materials, x0, x1, y0, y1, target, tile_stats);
+
+        int active = 0;
+        for (int j = y0; j < y1; ++j) {
+            for (int i = x0; i < x1; ++i) {
+                pixel_state& state = pixels[static_cast<size_t>(j - band_y) * image_width + i];
+                if (state.done)
+                    continue;
+
+                if (!wavefront) {
+                    for (int sample = state.count; sample < target; ++sample) {
+                        basic_sampler<T> sampler = start_sample(i, j, sample);
+                        ray r = get_ray(i, j, sampler);
+                        add_sample(state, trace_path(r, sampler, world, materials, tile_stats));
+                    }
+                }
+                state.count = std::max(state.count, target);
+
+                state.done = state.count >= samples_per_pixel || (adaptive && converged(state));
+                if (!state.done)
+                    ++active;
+            }
+        }
+        return active;
+    }
+
+    // A path being traced: the ray to follow next and the light gathered so far.
+    struct path_state {
+        ray        r;
+        color      throughput;
+        color      result;           // Light that has reached the camera along the path
+        hit_record rec;              // The hit being shaded in the current bounce
+        T          scatter_pdf = 0;  // Density of the last scatter direction if lights were sampled there too, else 0
+        T          cone_width = 0;   // Ray cone: width at the last hit, and the angle it widens by per unit of distance
+        T          cone_spread = 0;
+        basic_sampler<T> sampler;    // Random numbers of the path's sample
+        pcg32      rng;              // Wavefront only: the sample's random stream, swapped in while the path is shaded
+        size_t     pixel = 0;        // Wavefront only: index into `pixels`
+        color      albedo;           // Denoiser guides, from the first surface with a color of its own
+        vec3       normal;           // (zero where the path left the scene first)
+        bool       guided = false;   // Whether the guides have been taken yet
+    };
+
+    static void add_sample(pixel_state& state, const path_state& path) {
+        state.sum += path.result;
+        state.albedo_sum += path.albedo;
+        state.normal_sum += path.normal;
+
+        T lum = luminance(path.result);
+        state.lum_sum += lum;
+        state.lum_sq_sum += lum * lum;
+    }
+
+    void trace_tile_wavefront(const hittable& world, const material_table& materials, int x0, int x1, int y0, int y1,
+        int target, render_stats& tile_stats)
+    {
+        // Adds the samples up to `target` to the tile's unfinished pixels, like the loop in
+        // render_tile() but one bounce of every path at a time. Waves are filled in pixel and
+        // sample order and summed in that order, so each pixel adds its samples in the same
+        // sequence as before.
+        std::vector<path_state> paths;
+        std::vector<int> queue, next, scratch;
+        paths.reserve(std::max(wavefront_paths, 1));
+
+        int i = x0, j = y0;
+        int sample = 0;
+        bool have_pixel = false;
+        while (true) {
+            // Generate: fill the wave with camera rays of the next pixels and samples.
+            paths.clear();
+            while (static_cast<int>(paths.size()) < std::max(wavefront_paths, 1) && j < y1) {
+                size_t index = static_cast<size_t>(j - band_y) * image_width + i;
+                const pixel_state& state = pixels[index];
+                if (!have_pixel) {
+                    sample = state.count;
+                    have_pixel = true;
+                }
+                if (state.done || sample >= target) {
+                    have_pixel = false;
+                    if (++i == x1) {
+                        i = x0;
+                        ++j;
+                    }
+                    continue;
+                }
+
+                path_state path;
+                path.sampler = start_sample(i, j, sample++);
+                path.r = get_ray(i, j, path.sampler);
+                path.throughput = color(1, 1, 1);
+                path.cone_spread = pixel_spread;
+                path.rng = random_generator();
+                path.pixel = index;
+                paths.push_back(path);
+            }
+            if (paths.empty())
+                break;
+
+            tile_stats.primary_rays += paths.size();
+            queue.resize(paths.size());
+            for (size_t p = 0; p < paths.size(); ++p)
+                queue[p] = static_cast<int>(p);
+
+            for (int depth = 0; depth < max_depth && !queue.empty(); ++depth) {
+                if (depth > 0)
+                    tile_stats.secondary_rays += queue.size();
+
+                // Intersect: rays in the same octant tend to visit the BVH in the same order.
+                if (sort_rays) {
+                    sort_queue(queue, scratch, 8, [&paths](int p) {
+                        vec3 d = paths[p].r.direction();
+                        return (d.x() < 0 ? 1 : 0) | (d.y() < 0 ? 2 : 0) | (d.z() < 0 ? 4 : 0);
+                    });
+                }
+                next.clear();
+                for (int p : queue) {
+                    path_state& path = paths[p];
+                    if (world.hit(path.r, interval(T(0.001), std::numeric_limits<T>::infinity()), path.rec))
+                        next.push_back(p);
+                    else
+                        escape(path);
+                }
+                queue.swap(next);
+
+                // Shade: runs of one material keep its parameters and code path hot. Shadow rays
+                // for next-event estimation are traced right here rather than in a stage of their own.
+                if (sort_rays)
+                    sort_queue(queue, scratch, static_cast<int>(materials.size()), [&paths](int p) { return static_cast<int>(paths[p].rec.mat); });
+                next.clear();
+                for (int p : queue) {
+                    path_state& path = paths[p];
+                    random_generator() = path.rng;
+                    if (shade(path, depth, world, materials, tile_stats))
+                        next.push_back(p);
+                    path.rng = random_generator();
+                }
+                queue.swap(next);
+            }
+
+            for (const path_state& path : paths)
+                add_sample(pixels[path.pixel], path);
+        }
+    }
+
+    void escape(path_state& path) const {
+        color radiance = sky ? sky_color(path.r) : background;
+        path.result += path.throughput * radiance;
+        if (!path.guided) {
+            path.albedo = path.throughput * radiance;
+            path.guided = true;
+        }
+    }
+
+    bool shade(path_state& path, int depth, const hittable& world, const material_table& materials, render_stats& counts) const {
+        // One bounce at the hit in path.rec: adds the light the surface gives off and, on a
+        // diffuse surface, the light reaching it from a sampled emitter, then scatters. Returns
+        // false once the path has ended.
+        hit_record& rec = path.rec;
+        path.cone_width += path.cone_spread * rec.t * path.r.direction().length();
+        rec.footprint = path.cone_width;
+
+        // A textured material is read at the hit and replaced by the plain material it amounts
+        // to there, picked with a dimension of its own.
+        int dimension = first_bounce_dimension + depth * bounce_dimensions;
+        std::optional<basic_material<T>> lobe;
+        if (materials.textured(rec.mat)) {
+            path.sampler.set_dimension(dimension + lobe_dimension);
+            lobe = materials.resolve(path.r, rec, path.sampler);
+        }
+        const basic_material<T>& mat = lobe ? *lobe : materials[rec.mat];
+        path.sampler.set_dimension(dimension);
+
+        // Glass and mirrors pass the guides on to what is seen through them, tinted on the way.
+        color surface;
+        if (!path.guided && (material_table::guide(mat, surface) || depth + 1 == max_depth)) {
+            path.albedo = path.throughput * surface;
+            path.normal = rec.normal;
+            path.guided = true;
+        }
+
+        color emission = materials.emitted(rec.mat);
+        if (emission.length_squared() > 0) {
+            T weight = path.scatter_pdf > 0 ? power_heuristic(path.scatter_pdf, lights.pdf(path.r, rec)) : 1;
+            path.result += path.throughput * emission * weight;
+        }
+
+        // Lights are not sampled on the last bounce, where scattering could not find them
+        // either, so both strategies always cover the same paths.
+        color albedo;
+        bool sample_lights = next_event && !lights.empty() && depth + 1 < max_depth && material_table::diffuse(mat, albedo);
+        basic_light_sample<T> light;
+        if (sample_lights && lights.sample(rec.p, path.sampler, light)) {
+            T cos_surface = dot(rec.normal, light.direction);
+            if (cos_surface > 0) {
+                ++counts.secondary_rays;
+                hit_record blocker;
+                if (!world.hit(ray(rec.p, light.direction), interval(T(0.001), light.distance - T(0.001)), blocker)) {
+                    T brdf_pdf = cos_surface / static_cast<T>(pi);
+                    T weight = power_heuristic(light.pdf, brdf_pdf);
+                    path.result += path.throughput * albedo * light.emission * (brdf_pdf * weight / light.pdf);
+                }
+            }
+        }
+
+        ray scattered;
+        color attenuation;
+        if (!material_table::scatter(mat, path.r, rec, attenuation, scattered, path.sampler))
+            return false;
+        path.cone_spread += material_table::spread(mat);
+
+        path.scatter_pdf = sample_lights ? std::max(T(0), dot(rec.normal, unit_vector(scattered.direction()))) / static_cast<T>(pi) : 0;
+        path.throughput = path.throughput * attenuation;
+        path.r = scattered;
+
+        // Russian roulette: end dim paths early and boost the survivors by 1/p, which keeps
+        // the estimate unbiased.
+        if (depth + 1 >= rr_start_depth) {
+            auto p = fmin(fmax(path.throughput.x(), fmax(path.throughput.y(), path.throughput.z())), T(0.95));
+            if (path.sampler.get_1d() >= p)
+                return false;
+            path.throughput /= p;
+        }
+        return true;
+    }
+
+    void denoise_band(thread_pool& pool, std::vector<float>& framebuffer) const {
+        // Filters the resolved band, which is the whole image, in place.
+        auto start = std::chrono::steady_clock::now();
+        std::vector<float> albedo(framebuffer.size()), normal(framebuffer.size()), variance(pixels.size());
+        for (size_t index = 0; index < pixels.size(); ++index) {
+            const pixel_state& state = pixels[index];
+            T n = static_cast<T>(state.count);
+            color a = state.albedo_sum / n;
+            vec3 normal_mean = state.normal_sum / n;
+            for (int c = 0; c < 3; ++c) {
+                albedo[index * 3 + c] = static_cast<float>(a[c]);
+                normal[index * 3 + c] = static_cast<float>(normal_mean[c]);
+            }
+            T mean = state.lum_sum / n;
+            T sample_variance = std::max(T(0), (state.lum_sq_sum - mean * state.lum_sum) / std::max(n - 1, T(1)));
+            variance[index] = static_cast<float>(sample_variance / n);
+        }
+
+        int rows = static_cast<int>(pixels.size() / image_width);
+        denoise_filter.run(image_width, rows, framebuffer.data(), albedo.data(), normal.data(), variance.data(), pool);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::clog << "\rDenoised in " << elapsed.count() * 1000 << " ms\n";
+    }
+
+    static T power_heuristic(T pdf, T other_pdf) {
+        // Weight of a sample drawn with density `pdf` when `other_pdf` could also have drawn it.
+        T a = pdf * pdf, b = other_pdf * other_pdf;
+        return a / (a + b);
+    }
+
+    template <typename Key>
+    static void sort_queue(std::vector<int>& queue, std::vector<int>& scratch, int key_count, Key key) {
+        // Stable counting sort of path indices by a small integer key in [0, key_count).
+        std::vector<int> offsets(key_count + 1, 0);
+        for (int p : queue)
+            ++offsets[key(p) + 1];
+        for (int k = 0; k < key_count; ++k)
+            offsets[k + 1] += offsets[k];
+        scratch.resize(queue.size());
+        for (int p : queue)
+            scratch[offsets[key(p)]++] = p;
+        queue.swap(scratch);
+    }
+
+    bool converged(const pixel_state& state) const {
+        // Standard error of the mean luminance, carried through the sqrt gamma curve so the
+        // threshold is an error in displayed brightness (1/256 is one 8-bit step).
+        T n = static_cast<T>(state.count);
+        T mean = state.lum_sum / n;
+        T variance = std::max(T(0), (state.lum_sq_sum - mean * state.lum_sum) / std::max(n - 1, T(1)));
+        T error = sqrt(variance / n) / (2 * sqrt(std::max(mean, T(1e-4))));
+        return error <= error_threshold;
+    }
+
+    static T luminance(const color& c) {
+        return T(0.2126) * c.x() + T(0.7152) * c.y() + T(0.0722) * c.z();
+    }
+
+    // Sampler dimensions: the pixel position and lens position come first, then every bounce
+    // gets a fixed block, so a given decision draws from the same dimension in every sample.
+    static const int first_bounce_dimension = 2;
+    static const int bounce_dimensions = 8;
+    static const int lobe_dimension = bounce_dimensions - 1;  // Within a bounce's block: a textured material's choice of lobe
+
+    basic_sampler<T> start_sample(int i, int j, int sample) const {
+        // Each (pixel, sample) pair gets its own stream, so any sample can be reproduced alone.
+        auto pixel_index = static_cast<uint64_t>(j) * image_width + i;
+        seed_random(hash_seed(seed, pixel_index), static_cast<uint64_t>(sample));
+        return basic_sampler<T>(sampling, seed, i, j, sample, samples_per_pixel);
+    }
+
+    ray get_ray(int i, int j, basic_sampler<T>& sampler) const {
         // Get a randomly-sampled camera ray for the pixel at location i,j, originating from
         // the camera defocus disk.
 
         auto pixel_center = pixel00_loc + (i * pixel_delta_u) + (j * pixel_delta_v);
-        auto pixel_sample = pixel_center + pixel_sample_square();
+        sampler.set_dimension(0);
+        auto pixel_sample = pixel_center + pixel_sample_square(sampler);
 
-        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
+        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample(sampler);
         auto ray_direction = pixel_sample - ray_origin;
 
         return ray(ray_origin, ray_direction);
     }
 
-    point3 defocus_disk_sample() const {
+    point3 defocus_disk_sample(basic_sampler<T>& sampler) const {
         // Returns a random point in the camera defocus disk.
-        auto p = random_in_unit_disk();
+        auto p = sampler.in_unit_disk();
         return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
     }
 
-    vec3 pixel_sample_square() const {
+    vec3 pixel_sample_square(basic_sampler<T>& sampler) const {
         // Returns a random point in the square surrounding a pixel at the origin.
-        auto px = -0.5 + random_double();
-        auto py = -0.5 + random_double();
+        T px, py;
+        sampler.get_2d(px, py);
+        px -= T(0.5);
+        py -= T(0.5);
         return (px * pixel_delta_u) + (py * pixel_delta_v);
     }
 
-    color ray_color(const ray& r, int depth, const hittable& world) const {
-        hit_record rec;
-
-        // If we've exceeded the ray bounce limit, no more light is gathered.
-        if (depth <= 0)
-            return color(0, 0, 0);
-
-        if (world.hit(r, interval(0.001, infinity), rec)) {
-            ray scattered;
-            color attenuation;
-            if (rec.mat->scatter(r, rec, attenuation, scattered))
-                return attenuation * ray_color(scattered, depth - 1, world);
-            return color(0, 0, 0);
+    path_state trace_path(const ray& primary, const basic_sampler<T>& sampler, const hittable& world, const material_table& materials,
+        render_stats& counts) const
+    {
+        // Follows one path iteratively, carrying the product of attenuations so far.
+        path_state path;
+        path.sampler = sampler;
+        path.r = primary;
+        path.throughput = color(1, 1, 1);
+        path.cone_spread = pixel_spread;
+
+        ++counts.primary_rays;
+        for (int depth = 0; depth < max_depth; ++depth) {
+            if (depth > 0)
+                ++counts.secondary_rays;
+
+            if (!world.hit(path.r, interval(T(0.001), std::numeric_limits<T>::infinity()), path.rec)) {
+                escape(path);
+                break;
+            }
+            if (!shade(path, depth, world, materials, counts))
+                break;
         }
 
+        // Past the bounce limit no more light is gathered.
+        return path;
+    }
+
+    color sky_color(const ray& r) const {
         vec3 unit_direction = unit_vector(r.direction());
-        auto a = 0.5 * (unit_direction.y() + 1.0);
-        return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
+        auto a = T(0.5) * (unit_direction.y() + 1);
+        return (1 - a) * color(1, 1, 1) + a * color(T(0.5), T(0.7), T(1.0));
     }
 };
 
+using camera = basic_camera<double>;
+
 #endif
\ No newline at end of file
@@ -5,21 +5,24 @@
 
 #include <iostream>
 
-using color = vec3;
+template <typename T> using basic_color = basic_vec3<T>;
+using color = basic_color<double>;
 
-inline double linear_to_gamma(double linear_component)
+template <typename T>
+inline T linear_to_gamma(T linear_component)
 {
     return sqrt(linear_component);
 }
 
-color normal_to_color_space(color pixel_color, int samples_per_pixel)
+template <typename T>
+basic_color<T> normal_to_color_space(basic_color<T> pixel_color, int samples_per_pixel)
 {
     auto r = pixel_color.x();
     auto g = pixel_color.y();
     auto b = pixel_color.z();
 
     // Divide the color by the number of samples.
-    auto scale = 1.0 / samples_per_pixel;
+    auto scale = T(1) / samples_per_pixel;
     r *= scale;
     g *= scale;
     b *= scale;
@@ -30,21 +33,22 @@ color normal_to_color_space(color pixel_color, int samples_per_pixel)
     b = linear_to_gamma(b);
 
     // Write the translated [0,255] value of each color component.
-    static const interval intensity(0.000, 0.999);
-    r = static_cast<int>(256 * intensity.clamp(r));
-    g = static_cast<int>(256 * intensity.clamp(g));
-    b = static_cast<int>(256 * intensity.clamp(b));
+    static const basic_interval<T> intensity(T(0.000), T(0.999));
+    r = static_cast<T>(static_cast<int>(256 * intensity.clamp(r)));
+    g = static_cast<T>(static_cast<int>(256 * intensity.clamp(g)));
+    b = static_cast<T>(static_cast<int>(256 * intensity.clamp(b)));
 
-    return color(r, g, b);
+    return basic_color<T>(r, g, b);
 }
 
-void write_color(std::ostream& out, color pixel_color, int samples_per_pixel) {
+template <typename T>
+void write_color(std::ostream& out, basic_color<T> pixel_color, int samples_per_pixel) {
     auto r = pixel_color.x();
     auto g = pixel_color.y();
     auto b = pixel_color.z();
 
     // Divide the color by the number of samples.
-    auto scale = 1.0 / samples_per_pixel;
+    auto scale = T(1) / samples_per_pixel;
     r *= scale;
     g *= scale;
     b *= scale;
@@ -55,7 +59,7 @@ void write_color(std::ostream& out, color pixel_color, int samples_per_pixel) {
     b = linear_to_gamma(b);
 
     // Write the translated [0,255] value of each color component.
-    static const interval intensity(0.000, 0.999);
+    static const basic_interval<T> intensity(T(0.000), T(0.999));
     out << static_cast<int>(256 * intensity.clamp(r)) << ' '
         << static_cast<int>(256 * intensity.clamp(g)) << ' '
         << static_cast<int>(256 * intensity.clamp(b)) << '\n';
@@ -0,0 +1,225 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+
+// Edge-avoiding à-trous wavelet filter for a finished render (Dammertz et al. 2010, with the
+// variance-guided luminance weight of SVGF). Every pass blurs with a 5x5 B3-spline kernel whose
+// taps lie 2^pass pixels apart, and weights each tap down where its normal, albedo or brightness
+// differs from the center's by more than the noise explains. The albedo is divided out before
+// filtering and multiplied back in after, so only the lighting is blurred and surface color
+// edges stay sharp.
+class denoiser {
+public:
+    int   iterations = 5;        // Passes; the last one reaches 2 * 2^(iterations - 1) pixels out
+    float sigma_color = 4;       // Luminance difference tolerated, in standard deviations of the pixel noise
+    float sigma_albedo = 0.1f;   // Albedo difference that weighs a tap down by 1/e
+
+    // Filters `rgb`, width * height linear RGB triples, in place. `albedo` and `normal` hold a
+    // triple per pixel as well, with a zero normal where the camera ray left the scene, and
+    // `variance` the variance of each pixel's mean luminance.
+    void run(int width, int height, float* rgb, const float* albedo, const float* normal, const float* variance,
+        thread_pool& pool) const
+    {
+        int passes = std::max(iterations, 1);
+        const int lanes = packet::width;
+
+        // Planes of one float per pixel with a border around the image, wide enough for the
+        // widest pass, so taps never need clamping: border pixels are marked invalid and get no
+        // weight. Rows start on a register boundary, so the center pixels load aligned.
+        image img;
+        img.width = width;
+        img.height = height;
+        img.border = round_up(2 << (passes - 1), lanes);
+        img.stride = round_up(width, lanes) + 2 * img.border;
+        size_t plane_size = static_cast<size_t>(img.stride) * (height + 2 * img.border);
+        for (auto* plane : { &img.nx, &img.ny, &img.nz, &img.ar, &img.ag, &img.ab, &img.valid })
+            plane->assign(plane_size, 0);
+        channels buffers[2];
+        for (channels& c : buffers) {
+            for (auto* plane : { &c.r, &c.g, &c.b, &c.var })
+                plane->assign(plane_size, 0);
+        }
+
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                size_t in = (static_cast<size_t>(y) * width + x) * 3;
+                size_t at = img.index(x, y);
+                img.valid[at] = 1;
+                img.ar[at] = albedo[in + 0];
+                img.ag[at] = albedo[in + 1];
+                img.ab[at] = albedo[in + 2];
+
+                float length = std::sqrt(normal[in] * normal[in] + normal[in + 1] * normal[in + 1] + normal[in + 2] * normal[in + 2]);
+                if (length > 0) {
+                    img.nx[at] = normal[in + 0] / length;
+                    img.ny[at] = normal[in + 1] / length;
+                    img.nz[at] = normal[in + 2] / length;
+                }
+
+                float dr = demodulation(albedo[in + 0]), dg = demodulation(albedo[in + 1]), db = demodulation(albedo[in + 2]);
+                buffers[0].r[at] = rgb[in + 0] / dr;
+                buffers[0].g[at] = rgb[in + 1] / dg;
+                buffers[0].b[at] = rgb[in + 2] / db;
+                float scale = luminance(dr, dg, db);
+                buffers[0].var[at] = variance[static_cast<size_t>(y) * width + x] / (scale * scale);
+            }
+        }
+
+        // Each pass reads one buffer and writes the other, a band of rows per task.
+        const int band_rows = 8;
+        for (int pass = 0; pass < passes; ++pass) {
+            const channels& from = buffers[pass % 2];
+            channels& to = buffers[(pass + 1) % 2];
+            for (int y0 = 0; y0 < height; y0 += band_rows) {
+                pool.submit([&, y0, pass] {
+                    for (int y = y0; y < std::min(y0 + band_rows, height); ++y)
+                        filter_row(img, from, to, y, 1 << pass);
+                });
+            }
+            pool.wait();
+        }
+
+        const channels& result = buffers[passes % 2];
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                size_t out = (static_cast<size_t>(y) * width + x) * 3;
+                size_t at = img.index(x, y);
+                rgb[out + 0] = result.r[at] * demodulation(albedo[out + 0]);
+                rgb[out + 1] = result.g[at] * demodulation(albedo[out + 1]);
+                rgb[out + 2] = result.b[at] * demodulation(albedo[out + 2]);
+            }
+        }
+    }
+
+private:
+    using packet = simd_packet<float>;
+    using reg = packet::reg;
+
+    struct image {
+        int width, height;
+        int border;  // Pixels of padding on every side
+        int stride;  // Floats from one row to the next
+        aligned_vector<float> nx, ny, nz;  // Unit normal, or zero for escaped rays
+        aligned_vector<float> ar, ag, ab;  // Albedo
+        aligned_vector<float> valid;       // 1 inside the image, 0 in the border
+
+        size_t index(int x, int y) const {
+            return static_cast<size_t>(y + border) * stride + border + x;
+        }
+    };
+
+    // Lighting being filtered and the variance of its luminance.
+    struct channels {
+        aligned_vector<float> r, g, b, var;
+    };
+
+    static int round_up(int value, int multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    static float demodulation(float albedo) {
+        // Near-black albedo would blow the noise up when divided out, so it is left in.
+        return albedo > 0.01f ? albedo : 1.0f;
+    }
+
+    static float luminance(float r, float g, float b) {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+    static reg luminance(reg r, reg g, reg b) {
+        return packet::add(packet::add(packet::mul(packet::set1(0.2126f), r), packet::mul(packet::set1(0.7152f), g)),
+            packet::mul(packet::set1(0.0722f), b));
+    }
+
+    static reg square(reg a) { return packet::mul(a, a); }
+
+    void filter_row(const image& img, const channels& from, channels& to, int y, int step) const {
+        // One pass over row y, a register of pixels at a time. Pixels past the right edge of
+        // the image land in the border and are computed harmlessly along with the rest.
+        static const float kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+        const int lanes = packet::width;
+        const reg zero = packet::set1(0), one = packet::set1(1);
+        const reg albedo_scale = packet::set1(1 / (sigma_albedo * sigma_albedo));
+
+        for (int x = 0; x < img.width; x += lanes) {
+            size_t c = img.index(x, y);
+            reg cr = packet::load(&from.r[c]), cg = packet::load(&from.g[c]), cb = packet::load(&from.b[c]);
+            reg cv = packet::load(&from.var[c]);
+            reg cl = luminance(cr, cg, cb);
+            reg cnx = packet::load(&img.nx[c]), cny = packet::load(&img.ny[c]), cnz = packet::load(&img.nz[c]);
+            reg car = packet::load(&img.ar[c]), cag = packet::load(&img.ag[c]), cab = packet::load(&img.ab[c]);
+            reg c_escaped = packet::sub(one, packet::add(packet::add(square(cnx), square(cny)), square(cnz)));
+
+            // The luminance weight is scaled by the noise around the pixel: its variance blurred
+            // with a small Gaussian, as one pixel's own estimate is itself too noisy.
+            reg blurred = zero;
+            static const float gauss[3] = { 1.0f / 4, 1.0f / 8, 1.0f / 16 };
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const float* q = &from.var[c + static_cast<ptrdiff_t>(dy) * img.stride + dx];
+                    blurred = packet::add(blurred, packet::mul(packet::set1(gauss[std::abs(dx) + std::abs(dy)]), packet::loadu(q)));
+                }
+            }
+            reg luminance_scale = packet::div(one, packet::add(packet::mul(packet::set1(sigma_color), packet::sqrt(packet::max(blurred, zero))),
+                packet::set1(1e-4f)));
+
+            reg center_weight = packet::mul(packet::set1(kernel[2] * kernel[2]), packet::load(&img.valid[c]));
+            reg sum_w = center_weight;
+            reg sum_r = packet::mul(center_weight, cr), sum_g = packet::mul(center_weight, cg), sum_b = packet::mul(center_weight, cb);
+            reg sum_v = packet::mul(square(center_weight), cv);
+
+            for (int dy = -2; dy <= 2; ++dy) {
+                for (int dx = -2; dx <= 2; ++dx) {
+                    if (dx == 0 && dy == 0)
+                        continue;
+                    size_t q = c + (static_cast<ptrdiff_t>(dy) * img.stride + dx) * step;
+                    reg qr = packet::loadu(&from.r[q]), qg = packet::loadu(&from.g[q]), qb = packet::loadu(&from.b[q]);
+                    reg qnx = packet::loadu(&img.nx[q]), qny = packet::loadu(&img.ny[q]), qnz = packet::loadu(&img.nz[q]);
+
+                    // Normals: cosine to the 8th power, mild enough that pixels on a silhouette,
+                    // whose normal is an average, still find neighbors. Two escaped rays count as
+                    // facing the same way, an escaped ray and a surface as opposite.
+                    reg q_escaped = packet::sub(one, packet::add(packet::add(square(qnx), square(qny)), square(qnz)));
+                    reg cosine = packet::add(packet::add(packet::mul(cnx, qnx), packet::mul(cny, qny)), packet::mul(cnz, qnz));
+                    reg w_normal = packet::max(zero, packet::add(cosine, packet::mul(c_escaped, q_escaped)));
+                    for (int k = 0; k < 3; ++k)
+                        w_normal = square(w_normal);
+
+                    // Luminance and albedo share one exponential, exp(-e) ~ (1 - e/16)^16.
+                    reg dl = packet::sub(luminance(qr, qg, qb), cl);
+                    reg da = packet::add(packet::add(square(packet::sub(packet::loadu(&img.ar[q]), car)),
+                        square(packet::sub(packet::loadu(&img.ag[q]), cag))), square(packet::sub(packet::loadu(&img.ab[q]), cab)));
+                    reg e = packet::add(packet::mul(packet::max(dl, packet::sub(zero, dl)), luminance_scale), packet::mul(da, albedo_scale));
+                    reg w_edge = packet::max(zero, packet::sub(one, packet::mul(e, packet::set1(1.0f / 16))));
+                    for (int k = 0; k < 4; ++k)
+                        w_edge = square(w_edge);
+
+                    reg w = packet::mul(packet::mul(packet::set1(kernel[dx + 2] * kernel[dy + 2]), packet::loadu(&img.valid[q])),
+                        packet::mul(w_normal, w_edge));
+                    sum_w = packet::add(sum_w, w);
+                    sum_r = packet::add(sum_r, packet::mul(w, qr));
+                    sum_g = packet::add(sum_g, packet::mul(w, qg));
+                    sum_b = packet::add(sum_b, packet::mul(w, qb));
+                    sum_v = packet::add(sum_v, packet::mul(square(w), packet::loadu(&from.var[q])));
+                }
+            }
+
+            // The filtered variance follows the weights, so later passes know how much noise is left.
+            reg inv_w = packet::div(one, packet::max(sum_w, packet::set1(1e-20f)));
+            packet::store(&to.r[c], packet::mul(sum_r, inv_w));
+            packet::store(&to.g[c], packet::mul(sum_g, inv_w));
+            packet::store(&to.b[c], packet::mul(sum_b, inv_w));
+            packet::store(&to.var[c], packet::mul(sum_v, square(inv_w)));
+        }
+    }
+};
+
+#endif
@@ -3,30 +3,94 @@
 
 #include "rtweekend.h"
 
-class material;
+#include "aabb.h"
 
-class hit_record {
+#include <cstdint>
+
+// Index of a material in the scene's material table.
+using material_id = uint32_t;
+
+template <typename T> class basic_light_list;
+
+template <typename T>
+class basic_hit_record {
 public:
-    point3 p;
-    vec3 normal;
-    shared_ptr<material> mat;
-    double t;
+    basic_point3<T> p;
+    basic_vec3<T> normal;
+    material_id mat;
+    T t;
     bool front_face;
 
-    void set_face_normal(const ray& r, const vec3& outward_normal) {
+    // Texture coordinates and how the surface point moves with them, for image textures and
+    // their tangent frame. Both derivatives are zero where a surface has no coordinates. Spheres
+    // leave them to finish_uv(), as most materials never read them.
+    T u = 0, v = 0;
+    basic_vec3<T> dpdu, dpdv;
+    T pending_radius = 0;  // Radius of a sphere hit whose coordinates are still to be worked out
+
+    // The primitive that was hit, which the light list finds its light by: the object holding it,
+    // its index there, and the outermost instance placing it (null outside instances).
+    const void* object = nullptr;
+    const void* instance = nullptr;
+    int primitive = 0;
+
+    // Width of the ray cone at the hit, set by the camera before shading; textures are filtered
+    // over it. Zero asks for the finest detail.
+    T footprint = 0;
+
+    void set_face_normal(const basic_ray<T>& r, const basic_vec3<T>& outward_normal) {
         // Sets the hit record normal vector.
         // NOTE: the parameter `outward_normal` is assumed to have unit length.
 
         front_face = dot(r.direction(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    void set_primitive(const void* owner, int index) {
+        object = owner;
+        primitive = index;
+        instance = nullptr;
+    }
+
+    void defer_sphere_uv(T radius) {
+        // Called with the normal set, which finish_uv() reads the position on the sphere from.
+        pending_radius = radius;
+    }
+
+    void finish_uv() {
+        // Longitude and latitude of the book's sphere mapping: u runs once around the y axis
+        // starting from -x, v from the bottom pole (0) to the top (1).
+        if (pending_radius == 0)
+            return;
+        basic_vec3<T> outward_normal = front_face ? normal : -normal;
+        T x = outward_normal.x(), y = outward_normal.y(), z = outward_normal.z();
+        T ring = sqrt(x * x + z * z);
+        u = (atan2(-z, x) + static_cast<T>(pi)) / (2 * static_cast<T>(pi));
+        v = atan2(ring, -y) / static_cast<T>(pi);
+
+        // The partial derivatives of the mapping, which vanish in u at the poles.
+        dpdu = 2 * static_cast<T>(pi) * pending_radius * basic_vec3<T>(z, 0, -x);
+        dpdv = ring > 0 ? static_cast<T>(pi) * pending_radius * basic_vec3<T>(-x * y / ring, ring, -y * z / ring)
+            : basic_vec3<T>(0, 0, 0);
+        pending_radius = 0;
+    }
 };
 
-class hittable {
+template <typename T>
+class basic_hittable {
 public:
-    virtual ~hittable() = default;
+    virtual ~basic_hittable() = default;
+
+    virtual bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const = 0;
 
-    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+    virtual basic_aabb<T> bounding_box() const = 0;
+
+    // Adds every primitive with an emissive material to `lights` (see Lights.h). Containers pass
+    // the call on to what they hold; objects that cannot be sampled as lights add nothing.
+    virtual void add_lights(basic_light_list<T>& lights) const {}
 };
 
+using hit_record = basic_hit_record<double>;
+using hittable = basic_hittable<double>;
+
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define HITTABLE_LIST_H
 
 #include "hittable.h"
+#include "Lights.h"
 
 #include <memory>
 #include <vector>
@@ -9,26 +10,28 @@
 using std::shared_ptr;
 using std::make_shared;
 
-class hittable_list : public hittable {
+template <typename T>
+class basic_hittable_list : public basic_hittable<T> {
 public:
-    std::vector<shared_ptr<hittable>> objects;
+    std::vector<shared_ptr<basic_hittable<T>>> objects;
 
-    hittable_list() {}
-    hittable_list(shared_ptr<hittable> object) { add(object); }
+    basic_hittable_list() {}
+    basic_hittable_list(shared_ptr<basic_hittable<T>> object) { add(object); }
 
-    void clear() { objects.clear(); }
+    void clear() { objects.clear(); bbox = basic_aabb<T>(); }
 
-    void add(shared_ptr<hittable> object) {
+    void add(shared_ptr<basic_hittable<T>> object) {
         objects.push_back(object);
+        bbox = basic_aabb<T>(bbox, object->bounding_box());
     }
 
-    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-        hit_record temp_rec;
+    bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+        basic_hit_record<T> temp_rec;
         bool hit_anything = false;
         auto closest_so_far = ray_t.max;
 
         for (const auto& object : objects) {
-            if (object->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+            if (object->hit(r, basic_interval<T>(ray_t.min, closest_so_far), temp_rec)) {
                 hit_anything = true;
                 closest_so_far = temp_rec.t;
                 rec = temp_rec;
@@ -37,6 +40,18 @@ public:
 
         return hit_anything;
     }
+
+    basic_aabb<T> bounding_box() const override { return bbox; }
+
+    void add_lights(basic_light_list<T>& lights) const override {
+        for (const auto& object : objects)
+            object->add_lights(lights);
+    }
+
+private:
+    basic_aabb<T> bbox;
 };
 
-#endif
\ No newline at end of file
+using hittable_list = basic_hittable_list<double>;
+
+#endif
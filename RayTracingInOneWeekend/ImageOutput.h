@@ -0,0 +1,193 @@
+#ifndef IMAGE_OUTPUT_H
+#define IMAGE_OUTPUT_H
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "rtweekend.h"
+
+#include "color.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Writes a linear RGB float image, top to bottom, a band of rows at a time. The format comes
+// from the file extension:
+//   .hdr  Radiance RGBE, linear, streamed to disk as the rows arrive
+//   .ppm  binary 8-bit, gamma corrected, streamed to disk as the rows arrive
+//   .png  8-bit, gamma corrected; compressed in one go, so it is held in memory until close()
+class image_output {
+public:
+    enum class format { png, ppm, hdr };
+
+    image_output() {}
+    ~image_output() { if (file) fclose(file); }
+
+    image_output(const image_output&) = delete;
+    image_output& operator=(const image_output&) = delete;
+
+    static format format_of(const std::string& path) {
+        auto dot = path.find_last_of('.');
+        std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+        if (ext == "hdr") return format::hdr;
+        if (ext == "ppm") return format::ppm;
+        return format::png;
+    }
+
+    static bool can_stream(const std::string& path) {
+        return format_of(path) != format::png;
+    }
+
+    bool open(const std::string& path, int image_width, int image_height) {
+        this->path = path;
+        width = image_width;
+        height = image_height;
+        rows_written = 0;
+        fmt = format_of(path);
+
+        if (fmt == format::png) {
+            png_pixels.resize(static_cast<size_t>(width) * height * 3);
+            return true;
+        }
+
+        file = fopen(path.c_str(), "wb");
+        if (file == NULL) {
+            std::cerr << "Could not open '" << path << "' for writing\n";
+            return false;
+        }
+
+        if (fmt == format::hdr)
+            fprintf(file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", height, width);
+        else
+            fprintf(file, "P6\n%d %d\n255\n", width, height);
+        return true;
+    }
+
+    // Appends `row_count` rows of linear RGB floats, three per pixel.
+    void write_rows(int row_count, const float* rgb) {
+        for (int row = 0; row < row_count; ++row, ++rows_written) {
+            const float* src = rgb + static_cast<size_t>(row) * width * 3;
+
+            if (fmt == format::hdr) {
+                write_hdr_scanline(src);
+                continue;
+            }
+
+            unsigned char* dst;
+            if (fmt == format::png) {
+                dst = &png_pixels[static_cast<size_t>(rows_written) * width * 3];
+            }
+            else {
+                scanline.resize(static_cast<size_t>(width) * 3);
+                dst = scanline.data();
+            }
+            for (int x = 0; x < width; ++x) {
+                auto c = normal_to_color_space(basic_color<float>(src[x * 3], src[x * 3 + 1], src[x * 3 + 2]), 1);
+                dst[x * 3 + 0] = static_cast<unsigned char>(c.x());
+                dst[x * 3 + 1] = static_cast<unsigned char>(c.y());
+                dst[x * 3 + 2] = static_cast<unsigned char>(c.z());
+            }
+            if (fmt == format::ppm)
+                fwrite(dst, 1, static_cast<size_t>(width) * 3, file);
+        }
+    }
+
+    bool close() {
+        bool ok = rows_written == height;
+        if (fmt == format::png) {
+            ok = ok && stbi_write_png(path.c_str(), width, height, 3, png_pixels.data(), width * 3) != 0;
+            std::vector<unsigned char>().swap(png_pixels);
+        }
+        else if (file) {
+            ok = ok && ferror(file) == 0;
+            ok = fclose(file) == 0 && ok;
+            file = NULL;
+        }
+        if (!ok)
+            std::cerr << "Failed to write '" << path << "'\n";
+        return ok;
+    }
+
+private:
+    std::string path;
+    format fmt = format::png;
+    int width = 0, height = 0;
+    int rows_written = 0;
+    FILE* file = NULL;
+    std::vector<unsigned char> png_pixels;
+    std::vector<unsigned char> scanline;
+
+    void write_hdr_scanline(const float* src) {
+        // Shared-exponent RGBE, one byte plane per component so each can be run-length coded.
+        scanline.resize(static_cast<size_t>(width) * 4);
+        for (int x = 0; x < width; ++x) {
+            float r = std::max(src[x * 3], 0.0f), g = std::max(src[x * 3 + 1], 0.0f), b = std::max(src[x * 3 + 2], 0.0f);
+            float v = std::max(r, std::max(g, b));
+            unsigned char rgbe[4] = { 0, 0, 0, 0 };
+            if (v >= 1e-32f) {
+                int exponent;
+                float scale = std::frexp(v, &exponent) * 256.0f / v;
+                rgbe[0] = static_cast<unsigned char>(r * scale);
+                rgbe[1] = static_cast<unsigned char>(g * scale);
+                rgbe[2] = static_cast<unsigned char>(b * scale);
+                rgbe[3] = static_cast<unsigned char>(exponent + 128);
+            }
+            for (int c = 0; c < 4; ++c)
+                scanline[static_cast<size_t>(c) * width + x] = rgbe[c];
+        }
+
+        // Readers only accept run-length coding for widths in [8, 32767]; outside that the
+        // pixels are stored flat.
+        if (width < 8 || width > 32767) {
+            for (int x = 0; x < width; ++x)
+                for (int c = 0; c < 4; ++c)
+                    fputc(scanline[static_cast<size_t>(c) * width + x], file);
+            return;
+        }
+
+        unsigned char header[4] = { 2, 2, static_cast<unsigned char>(width >> 8), static_cast<unsigned char>(width & 255) };
+        fwrite(header, 1, 4, file);
+        for (int c = 0; c < 4; ++c)
+            write_rle_plane(&scanline[static_cast<size_t>(c) * width]);
+    }
+
+    void write_rle_plane(const unsigned char* data) {
+        // A count byte above 128 repeats the next byte (count - 128) times; otherwise it is
+        // followed by that many literal bytes.
+        int x = 0;
+        while (x < width) {
+            int run = x;
+            while (run + 2 < width && !(data[run] == data[run + 1] && data[run] == data[run + 2]))
+                ++run;
+            if (run + 2 >= width)
+                run = width;
+
+            while (x < run) {
+                int length = std::min(run - x, 128);
+                fputc(length, file);
+                fwrite(data + x, 1, length, file);
+                x += length;
+            }
+
+            if (run < width) {
+                int end = run;
+                while (end < width && data[end] == data[run])
+                    ++end;
+                while (x < end) {
+                    int length = std::min(end - x, 127);
+                    fputc(128 + length, file);
+                    fputc(data[run], file);
+                    x += length;
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "hittable.h"
+
+#include <cstdint>
+#include <vector>
+
+// An affine transform: a row-major 3x3 linear part followed by a translation.
+template <typename T>
+class basic_transform {
+public:
+    T m[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    basic_vec3<T> offset;
+
+    static basic_transform translate(const basic_vec3<T>& v) {
+        basic_transform result;
+        result.offset = v;
+        return result;
+    }
+
+    static basic_transform scale(const basic_vec3<T>& s) {
+        basic_transform result;
+        for (int i = 0; i < 3; i++)
+            result.m[i][i] = s[i];
+        return result;
+    }
+
+    static basic_transform rotate(const basic_vec3<T>& axis, T degrees) {
+        // Rodrigues' rotation formula, counter-clockwise looking down the axis.
+        auto k = unit_vector(axis);
+        auto theta = degrees_to_radians(degrees);
+        T c = std::cos(theta), s = std::sin(theta), t = 1 - c;
+        basic_transform result;
+        result.m[0][0] = t * k.x() * k.x() + c;
+        result.m[0][1] = t * k.x() * k.y() - s * k.z();
+        result.m[0][2] = t * k.x() * k.z() + s * k.y();
+        result.m[1][0] = t * k.x() * k.y() + s * k.z();
+        result.m[1][1] = t * k.y() * k.y() + c;
+        result.m[1][2] = t * k.y() * k.z() - s * k.x();
+        result.m[2][0] = t * k.x() * k.z() - s * k.y();
+        result.m[2][1] = t * k.y() * k.z() + s * k.x();
+        result.m[2][2] = t * k.z() * k.z() + c;
+        return result;
+    }
+
+    // This transform followed by `next`.
+    basic_transform then(const basic_transform& next) const {
+        basic_transform result;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++)
+                result.m[i][j] = next.m[i][0] * m[0][j] + next.m[i][1] * m[1][j] + next.m[i][2] * m[2][j];
+        }
+        result.offset = next.point(offset);
+        return result;
+    }
+
+    basic_vec3<T> vector(const basic_vec3<T>& v) const {
+        return basic_vec3<T>(
+            m[0][0] * v.x() + m[0][1] * v.y() + m[0][2] * v.z(),
+            m[1][0] * v.x() + m[1][1] * v.y() + m[1][2] * v.z(),
+            m[2][0] * v.x() + m[2][1] * v.y() + m[2][2] * v.z());
+    }
+
+    basic_point3<T> point(const basic_point3<T>& p) const {
+        return vector(p) + offset;
+    }
+
+    // Multiplies by the transposed linear part; with an inverse transform that maps normals.
+    basic_vec3<T> transposed_vector(const basic_vec3<T>& v) const {
+        return basic_vec3<T>(
+            m[0][0] * v.x() + m[1][0] * v.y() + m[2][0] * v.z(),
+            m[0][1] * v.x() + m[1][1] * v.y() + m[2][1] * v.z(),
+            m[0][2] * v.x() + m[1][2] * v.y() + m[2][2] * v.z());
+    }
+
+    T determinant() const {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+            - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+            + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    basic_transform inverse() const {
+        // Adjugate over determinant; callers make sure the transform is not singular.
+        T inv_det = 1 / determinant();
+        basic_transform result;
+        result.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det;
+        result.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det;
+        result.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+        result.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv_det;
+        result.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+        result.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det;
+        result.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+        result.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det;
+        result.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+        result.offset = -result.vector(offset);
+        return result;
+    }
+};
+
+// One step of a transform as a scene file writes it, kept as parameters rather than a matrix so
+// keyframed steps can be blended: translate by x y z, rotate about axis x y z by degrees, or
+// scale by x y z.
+template <typename T>
+struct basic_transform_step {
+    enum kind : uint32_t { translate, rotate, scale };
+
+    kind type = translate;
+    T values[4] = { 0, 0, 0, 0 };
+
+    basic_transform<T> make() const {
+        basic_vec3<T> v(values[0], values[1], values[2]);
+        if (type == rotate)
+            return basic_transform<T>::rotate(v, values[3]);
+        if (type == scale)
+            return basic_transform<T>::scale(v);
+        return basic_transform<T>::translate(v);
+    }
+
+    // Blends every parameter linearly; a rotation's axis and angle separately, so one going from
+    // 0 to 360 degrees turns a full circle rather than standing still. Both steps are of one kind.
+    static basic_transform_step blend(const basic_transform_step& a, const basic_transform_step& b, T t) {
+        basic_transform_step result = a;
+        for (int i = 0; i < 4; i++)
+            result.values[i] = a.values[i] + (b.values[i] - a.values[i]) * t;
+        return result;
+    }
+
+    // The steps applied in order.
+    static basic_transform<T> compose(const std::vector<basic_transform_step>& steps) {
+        basic_transform<T> result;
+        for (const auto& step : steps)
+            result = result.then(step.make());
+        return result;
+    }
+};
+
+// Places a shared object, typically a triangle mesh, in the world with its own transform and
+// material. The ray is moved into object space rather than the object into world space, so
+// any number of instances share one copy of the geometry and its BVH. An emissive instance adds
+// its object's primitives to the light list placed in the world.
+template <typename T>
+class basic_instance : public basic_hittable<T> {
+public:
+    basic_instance(shared_ptr<basic_hittable<T>> object, const basic_transform<T>& object_to_world, material_id m)
+        : object(object), mat(m)
+    {
+        set_transform(object_to_world);
+    }
+
+    // Moves the instance. A BVH holding it needs a refit or rebuild afterwards.
+    void set_transform(const basic_transform<T>& object_to_world) {
+        to_world = object_to_world;
+        to_object = object_to_world.inverse();
+
+        auto box = object->bounding_box();
+        bbox = basic_aabb<T>();
+        for (int corner = 0; corner < 8; corner++) {
+            basic_point3<T> p((corner & 1) ? box.x.max : box.x.min, (corner & 2) ? box.y.max : box.y.min,
+                (corner & 4) ? box.z.max : box.z.min);
+            auto q = to_world.point(p);
+            bbox = basic_aabb<T>(bbox, basic_aabb<T>(q, q));
+        }
+    }
+
+    const basic_transform<T>& transform() const { return to_world; }
+
+    bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+        // The direction is not renormalized, so distances along the ray are the same in both spaces.
+        basic_ray<T> local(to_object.point(r.origin()), to_object.vector(r.direction()));
+        if (!object->hit(local, ray_t, rec))
+            return false;
+
+        rec.p = r.at(rec.t);
+        rec.finish_uv();
+        rec.normal = unit_vector(to_object.transposed_vector(rec.normal));
+        rec.dpdu = to_world.vector(rec.dpdu);
+        rec.dpdv = to_world.vector(rec.dpdv);
+        rec.mat = mat;
+        rec.instance = this;
+        return true;
+    }
+
+    basic_aabb<T> bounding_box() const override { return bbox; }
+
+    void add_lights(basic_light_list<T>& lights) const override {
+        lights.add_instance(this, to_world, mat, *object);
+    }
+
+private:
+    shared_ptr<basic_hittable<T>> object;
+    basic_transform<T> to_world;
+    basic_transform<T> to_object;
+    material_id mat;
+    basic_aabb<T> bbox;
+};
+
+using transform = basic_transform<double>;
+using transform_step = basic_transform_step<double>;
+using instance = basic_instance<double>;
+
+#endif
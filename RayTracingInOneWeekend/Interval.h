@@ -1,32 +1,42 @@
 #ifndef INTERVAL_H
 #define INTERVAL_H
 
-class interval {
+template <typename T>
+class basic_interval {
 public:
-    double min, max;
+    T min, max;
 
-    interval() : min(+infinity), max(-infinity) {} // Default interval is empty
+    basic_interval() : min(+std::numeric_limits<T>::infinity()), max(-std::numeric_limits<T>::infinity()) {} // Default interval is empty
 
-    interval(double _min, double _max) : min(_min), max(_max) {}
+    basic_interval(T _min, T _max) : min(_min), max(_max) {}
 
-    bool contains(double x) const {
+    basic_interval(const basic_interval& a, const basic_interval& b)
+        : min(fmin(a.min, b.min)), max(fmax(a.max, b.max)) {}
+
+    T size() const {
+        return max - min;
+    }
+
+    bool contains(T x) const {
         return min <= x && x <= max;
     }
 
-    bool surrounds(double x) const {
+    bool surrounds(T x) const {
         return min < x && x < max;
     }
 
-    double clamp(double x) const {
+    T clamp(T x) const {
         if (x < min) return min;
         if (x > max) return max;
         return x;
     }
 
-    static const interval empty, universe;
+    static const basic_interval empty, universe;
 };
 
+using interval = basic_interval<double>;
+
 const static interval empty(+infinity, -infinity);
 const static interval universe(-infinity, +infinity);
 
-#endif
\ No newline at end of file
+#endif
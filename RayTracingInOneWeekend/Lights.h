@@ -0,0 +1,284 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "rtweekend.h"
+
+#include "color.h"
+#include "hittable.h"
+#include "Instance.h"
+#include "material.h"
+#include "Sampler.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// A point picked on a light for next-event estimation, as seen from the shading point.
+template <typename T>
+struct basic_light_sample {
+    basic_vec3<T>  direction; // Unit vector from the shading point towards the light
+    T              distance;  // Distance to the sampled point along `direction`
+    basic_color<T> emission;  // Radiance leaving the light towards the shading point
+    T              pdf;       // Solid-angle density of the sample, including the choice of light
+};
+
+// Every emissive sphere and triangle of a scene, for sampling lights directly. Lights are picked
+// in proportion to their power, then a point on the chosen one: spheres by the cone of directions
+// they subtend, triangles uniformly by area. Emitters give off light from both sides. Each light
+// is keyed by the primitive it came from, so a hit finds its light without searching.
+template <typename T>
+class basic_light_list {
+public:
+    // Collects the emitters of `world` afresh.
+    void build(const basic_hittable<T>& world, const basic_material_table<T>& materials) {
+        lights.clear();
+        by_primitive.clear();
+        table = &materials;
+        placement = placed();
+        stretched = 0;
+        world.add_lights(*this);
+        table = nullptr;
+        if (stretched > 0)
+            std::clog << stretched << " emissive spheres are stretched by their instance and not sampled as lights\n";
+
+        // Selection probabilities by emitted power, and a cumulative table to pick from.
+        T total = 0;
+        for (const auto& light : lights)
+            total += light.power;
+        cdf.resize(lights.size());
+        T running = 0;
+        for (size_t i = 0; i < lights.size(); ++i) {
+            lights[i].select_pdf = lights[i].power / total;
+            running += lights[i].power;
+            cdf[i] = running / total;
+        }
+    }
+
+    bool empty() const { return lights.empty(); }
+    size_t size() const { return lights.size(); }
+
+    // Whether primitives of material `mat` give off light where they are being added, so objects
+    // can skip listing ones that do not. Only valid inside build().
+    bool emits(material_id mat) const {
+        return table->emitted(placement.instance ? placement.mat : mat).length_squared() > 0;
+    }
+
+    // Adds a sphere that hit records name by `object` and `primitive` (see
+    // basic_hit_record::set_primitive()). Inside an instance its transform and material apply.
+    void add_sphere(const basic_point3<T>& center, T radius, material_id mat, const void* object, int primitive) {
+        light l;
+        l.is_sphere = true;
+        l.a = center;
+        l.radius = radius;
+        if (placement.instance) {
+            T scale;
+            if (!uniform_scale(placement.to_world, scale)) {
+                if (emits(mat))
+                    stretched++;
+                return;
+            }
+            l.a = placement.to_world.point(center);
+            l.radius = radius * scale;
+        }
+        l.emission = table->emitted(placement.instance ? placement.mat : mat);
+        l.power = luminance(l.emission) * 4 * static_cast<T>(pi) * l.radius * l.radius;
+        add(l, object, primitive);
+    }
+
+    void add_triangle(const basic_point3<T>& a, const basic_point3<T>& b, const basic_point3<T>& c, material_id mat,
+        const void* object, int primitive)
+    {
+        light l;
+        l.is_sphere = false;
+        l.a = placement.instance ? placement.to_world.point(a) : a;
+        l.edge1 = (placement.instance ? placement.to_world.point(b) : b) - l.a;
+        l.edge2 = (placement.instance ? placement.to_world.point(c) : c) - l.a;
+        auto n = cross(l.edge1, l.edge2);
+        l.area = n.length() / 2;
+        if (l.area <= 0)
+            return;
+        l.normal = unit_vector(n);
+        l.emission = table->emitted(placement.instance ? placement.mat : mat);
+        l.power = luminance(l.emission) * l.area;
+        add(l, object, primitive);
+    }
+
+    // Adds the lights of `object` as `instance` places it. Nested instances compose their
+    // transforms, while the outermost one names the hits and sets the material, as in
+    // basic_instance::hit().
+    void add_instance(const void* instance, const basic_transform<T>& object_to_world, material_id mat,
+        const basic_hittable<T>& object)
+    {
+        placed outer = placement;
+        placement.to_world = outer.instance ? object_to_world.then(outer.to_world) : object_to_world;
+        if (!outer.instance) {
+            placement.instance = instance;
+            placement.mat = mat;
+        }
+        if (emits(mat))
+            object.add_lights(*this);
+        placement = outer;
+    }
+
+    // Picks a light and a point on it to connect `origin` to. Returns false if the draw gave
+    // nothing usable, e.g. from inside a light sphere; pdf() is zero for those directions too.
+    bool sample(const basic_point3<T>& origin, basic_sampler<T>& sampler, basic_light_sample<T>& s) const {
+        if (lights.empty())
+            return false;
+
+        auto pick = std::lower_bound(cdf.begin(), cdf.end(), sampler.get_1d());
+        T u, v;
+        sampler.get_2d(u, v);
+        const light& l = lights[std::min(static_cast<size_t>(pick - cdf.begin()), lights.size() - 1)];
+
+        T pdf;
+        if (l.is_sphere) {
+            basic_vec3<T> to_center = l.a - origin;
+            T dist_sq = to_center.length_squared();
+            T r_sq = l.radius * l.radius;
+            if (dist_sq <= r_sq)
+                return false;
+
+            // Uniform over the cone around the center; 1 - cos is written so it stays accurate
+            // for small, distant spheres.
+            T sin_sq_max = r_sq / dist_sq;
+            T cos_max = sqrt(1 - sin_sq_max);
+            T one_minus_cos_max = sin_sq_max / (1 + cos_max);
+            T cos_theta = 1 - u * one_minus_cos_max;
+            T sin_theta = sqrt(std::max(T(0), 1 - cos_theta * cos_theta));
+            T phi = 2 * static_cast<T>(pi) * v;
+
+            basic_vec3<T> w = to_center / sqrt(dist_sq);
+            basic_vec3<T> a = fabs(w.x()) > T(0.9) ? basic_vec3<T>(0, 1, 0) : basic_vec3<T>(1, 0, 0);
+            basic_vec3<T> e = unit_vector(cross(w, a));
+            basic_vec3<T> b = cross(w, e);
+            s.direction = unit_vector(sin_theta * std::cos(phi) * b + sin_theta * std::sin(phi) * e + cos_theta * w);
+
+            // Nearest intersection with the sphere, or the tangent point for a grazing direction.
+            T half_b = dot(to_center, s.direction);
+            T discriminant = half_b * half_b - (dist_sq - r_sq);
+            s.distance = half_b - sqrt(std::max(T(0), discriminant));
+            pdf = 1 / (2 * static_cast<T>(pi) * one_minus_cos_max);
+        }
+        else {
+            T su = sqrt(u);
+            basic_point3<T> p = l.a + su * (1 - v) * l.edge1 + su * v * l.edge2;
+            basic_vec3<T> to_point = p - origin;
+            T dist_sq = to_point.length_squared();
+            s.distance = sqrt(dist_sq);
+            if (s.distance <= 0)
+                return false;
+            s.direction = to_point / s.distance;
+            T cos_light = fabs(dot(l.normal, s.direction));
+            if (cos_light <= 0)
+                return false;
+            pdf = dist_sq / (cos_light * l.area);
+        }
+
+        s.emission = l.emission;
+        s.pdf = pdf * l.select_pdf;
+        return s.pdf > 0;
+    }
+
+    // The density with which sample() picks the point `rec` that the ray `r` hit, or zero if it is
+    // not on a listed light.
+    T pdf(const basic_ray<T>& r, const basic_hit_record<T>& rec) const {
+        auto found = by_primitive.find(key{ rec.object, rec.instance, rec.primitive });
+        if (found == by_primitive.end())
+            return 0;
+
+        const light& l = lights[found->second];
+        T length = r.direction().length();
+        if (l.is_sphere) {
+            T dist_sq = (l.a - r.origin()).length_squared();
+            T r_sq = l.radius * l.radius;
+            if (dist_sq <= r_sq)
+                return 0;
+            T sin_sq_max = r_sq / dist_sq;
+            T one_minus_cos_max = sin_sq_max / (1 + sqrt(1 - sin_sq_max));
+            return l.select_pdf / (2 * static_cast<T>(pi) * one_minus_cos_max);
+        }
+
+        T distance = rec.t * length;
+        T cos_light = fabs(dot(l.normal, r.direction())) / length;
+        if (cos_light <= 0)
+            return 0;
+        return l.select_pdf * distance * distance / (cos_light * l.area);
+    }
+
+private:
+    struct light {
+        bool            is_sphere;
+        basic_point3<T> a;             // Sphere center, or the triangle's first vertex
+        T               radius = 0;
+        basic_vec3<T>   edge1, edge2;  // Triangle edges from `a`
+        basic_vec3<T>   normal;
+        T               area = 0;
+        basic_color<T>  emission;
+        T               power;
+        T               select_pdf = 0;
+    };
+
+    // What a hit record names its primitive by.
+    struct key {
+        const void* object;
+        const void* instance;
+        int primitive;
+
+        bool operator==(const key& other) const {
+            return object == other.object && instance == other.instance && primitive == other.primitive;
+        }
+    };
+
+    struct key_hash {
+        size_t operator()(const key& k) const {
+            size_t h = std::hash<const void*>()(k.object);
+            h = h * 31 + std::hash<const void*>()(k.instance);
+            return h * 31 + std::hash<int>()(k.primitive);
+        }
+    };
+
+    // The instance the lights being added are placed by, while build() runs.
+    struct placed {
+        const void* instance = nullptr;
+        basic_transform<T> to_world;
+        material_id mat = 0;
+    };
+
+    std::vector<light> lights;
+    std::vector<T> cdf;
+    std::unordered_map<key, int, key_hash> by_primitive;
+    const basic_material_table<T>* table = nullptr;
+    placed placement;
+    int stretched = 0;
+
+    void add(const light& l, const void* object, int primitive) {
+        if (!(l.power > 0))
+            return;
+        by_primitive[key{ object, placement.instance, primitive }] = static_cast<int>(lights.size());
+        lights.push_back(l);
+    }
+
+    // Whether `t` scales every direction alike, as a sphere needs to stay one; `scale` is by how much.
+    static bool uniform_scale(const basic_transform<T>& t, T& scale) {
+        basic_vec3<T> x = t.vector(basic_vec3<T>(1, 0, 0));
+        basic_vec3<T> y = t.vector(basic_vec3<T>(0, 1, 0));
+        basic_vec3<T> z = t.vector(basic_vec3<T>(0, 0, 1));
+        scale = x.length();
+        T tolerance = T(1e-6) * scale;
+        return fabs(y.length() - scale) <= tolerance && fabs(z.length() - scale) <= tolerance
+            && fabs(dot(x, y)) <= tolerance * scale && fabs(dot(y, z)) <= tolerance * scale
+            && fabs(dot(z, x)) <= tolerance * scale;
+    }
+
+    static T luminance(const basic_color<T>& c) {
+        return T(0.2126) * c.x() + T(0.7152) * c.y() + T(0.0722) * c.z();
+    }
+};
+
+using light_sample = basic_light_sample<double>;
+using light_list = basic_light_list<double>;
+
+#endif
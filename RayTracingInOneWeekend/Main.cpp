@@ -1,70 +1,134 @@
 #include "RTWeekend.h"
 
 #include "camera.h"
-#include "color.h"
-#include "HittableList.h"
-#include "material.h"
-#include "sphere.h"
+#include "Region.h"
+#include "SceneFile.h"
+#include "Scenes.h"
+#include "Sequence.h"
 
-int main() {
-    hittable_list world;
-
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
-
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
 
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
+// Usage:
+//   RayTracingInOneWeekend [--scene <file>] [--denoise]                      render image.png in this process
+//   RayTracingInOneWeekend [--scene <file>] --region <index> <count> [path]  render one region to a region buffer (default stdout)
+//   RayTracingInOneWeekend --merge <image> <buffers...>                      merge region buffers, e.g. from a shared directory
+//   RayTracingInOneWeekend [--scene <file>] --spawn <count> [image]          render with <count> local worker processes over pipes
+//   RayTracingInOneWeekend --compile <scene> <binary scene>                  build a scene's BVHs once and save the binary form
+//   RayTracingInOneWeekend --scene <file> [--denoise] --sequence [pattern]   render an animated scene's frames, by default
+//                                                                            to frame####.png
+// Without --scene the book's random spheres are generated in code; ../Assets/Scenes holds them as a file.
+// --denoise filters the finished image (see Denoiser.h), which needs all of it in one process.
+int main(int argc, char* argv[]) {
+    std::string scene_path;
+    bool denoise = false;
+    while (argc > 1) {
+        if (argc > 2 && strcmp(argv[1], "--scene") == 0) {
+            scene_path = argv[2];
+            argv[2] = argv[0];
+            argv += 2;
+            argc -= 2;
+        }
+        else if (strcmp(argv[1], "--denoise") == 0) {
+            denoise = true;
+            argv[1] = argv[0];
+            argv += 1;
+            argc -= 1;
+        }
+        else {
+            break;
+        }
+    }
+    if (denoise && argc > 1 && strcmp(argv[1], "--sequence") != 0) {
+        std::cerr << "--denoise needs the whole image rendered in this process\n";
+        return 1;
+    }
 
-                if (choose_mat < 0.8) {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-            }
+    if (argc > 1 && strcmp(argv[1], "--merge") == 0) {
+        if (argc < 4) {
+            std::cerr << "--merge needs an output image and at least one region buffer\n";
+            return 1;
+        }
+        std::vector<region_buffer> regions(argc - 3);
+        for (int i = 3; i < argc; ++i) {
+            if (!regions[i - 3].load(argv[i]))
+                return 1;
         }
+        return merge_regions(regions, argv[2]) ? 0 : 1;
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+    if (argc > 1 && strcmp(argv[1], "--spawn") == 0) {
+        int count = argc > 2 ? atoi(argv[2]) : 0;
+        if (count < 1) {
+            std::cerr << "--spawn needs a worker count\n";
+            return 1;
+        }
+        std::string worker_command = std::string("\"") + argv[0] + "\"";
+        if (!scene_path.empty())
+            worker_command += " --scene \"" + scene_path + "\"";
+        worker_command += " --region";
+        return render_distributed(worker_command, count, argc > 3 ? argv[3] : "image.png") ? 0 : 1;
+    }
 
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+    if (argc > 1 && strcmp(argv[1], "--compile") == 0) {
+        if (argc != 4) {
+            std::cerr << "--compile needs a scene file and an output path\n";
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        scene compiled;
+        if (!load_scene(argv[2], compiled))
+            return 1;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::clog << "Loaded and built '" << argv[2] << "' in " << elapsed.count() << " s\n";
+        return save_scene_binary(argv[3], compiled) ? 0 : 1;
+    }
 
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+    if (argc > 1 && strcmp(argv[1], "--sequence") == 0) {
+        scene animated;
+        if (scene_path.empty() || !load_scene(scene_path, animated)) {
+            std::cerr << "--sequence needs an animated scene given with --scene\n";
+            return 1;
+        }
+        animated.cam.denoise = denoise;
+        sequence_renderer sequence;
+        return sequence.render(animated, argc > 2 ? argv[2] : "frame####.png") ? 0 : 1;
+    }
 
+    material_table materials;
+    hittable_list world;
     camera cam;
 
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.image_width = 1200;
-    cam.samples_per_pixel = 10;
-    cam.max_depth = 10;
-
-    cam.vfov = 20;
-    cam.lookfrom = point3(13, 2, 3);
-    cam.lookat = point3(0, 0, 0);
-    cam.vup = vec3(0, 1, 0);
+    if (scene_path.empty()) {
+        world = random_spheres_scene<double>(materials);
+        random_spheres_camera(cam);
+    }
+    else {
+        auto start = std::chrono::steady_clock::now();
+        scene loaded;
+        if (!load_scene(scene_path, loaded))
+            return 1;
+        materials = loaded.materials;
+        world = loaded.world();
+        cam = loaded.cam;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::clog << "Loaded '" << scene_path << "' in " << elapsed.count() * 1000 << " ms\n";
+    }
 
-    cam.defocus_angle = 0.6;
-    cam.focus_dist = 10.0;
+    if (argc > 1 && strcmp(argv[1], "--region") == 0) {
+        if (argc < 4) {
+            std::cerr << "--region needs a region index and count\n";
+            return 1;
+        }
+        cam.region_index = atoi(argv[2]);
+        cam.region_count = atoi(argv[3]);
+        cam.output_path = argc > 4 ? argv[4] : "-";
+    }
 
-    cam.render(world);
-}
\ No newline at end of file
+    cam.denoise = denoise;
+    cam.render(world, materials);
+}
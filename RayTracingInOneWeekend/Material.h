@@ -3,88 +3,288 @@
 
 #include "rtweekend.h"
 
-class hit_record;
+#include "hittable.h"
+#include "Sampler.h"
+#include "Texture.h"
 
-class material {
-public:
-    virtual ~material() = default;
-
-    virtual bool scatter(
-        const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
-};
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <variant>
+#include <vector>
 
-class lambertian : public material {
+template <typename T>
+class basic_lambertian {
 public:
-    lambertian(const color& a) : albedo(a) {}
+    basic_lambertian(const basic_color<T>& a) : albedo(a) {}
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
-        auto scatter_direction = rec.normal + random_unit_vector();
+    bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_color<T>& attenuation, basic_ray<T>& scattered,
+        basic_sampler<T>& sampler) const {
+        auto scatter_direction = rec.normal + sampler.unit_vector();
 
         // Catch degenerate scatter direction
         if (scatter_direction.near_zero())
             scatter_direction = rec.normal;
 
-        scattered = ray(rec.p, scatter_direction);
+        scattered = basic_ray<T>(rec.p, scatter_direction);
         attenuation = albedo;
         return true;
     }
 
+    const basic_color<T>& reflectance() const { return albedo; }
+
 private:
-    color albedo;
+    basic_color<T> albedo;
 };
 
-class metal : public material {
+template <typename T>
+class basic_metal {
 public:
-    metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+    basic_metal(const basic_color<T>& a, T f) : albedo(a), fuzz(f < 1 ? f : 1) {}
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
-        vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-        scattered = ray(rec.p, reflected + fuzz * random_unit_vector());
+    bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_color<T>& attenuation, basic_ray<T>& scattered,
+        basic_sampler<T>& sampler) const {
+        basic_vec3<T> reflected = reflect(unit_vector(r_in.direction()), rec.normal);
+        scattered = basic_ray<T>(rec.p, reflected + fuzz * sampler.unit_vector());
         attenuation = albedo;
         return (dot(scattered.direction(), rec.normal) > 0);
         return true;
     }
 
+    const basic_color<T>& reflectance() const { return albedo; }
+    T roughness() const { return fuzz; }
+
 private:
-    color albedo;
-    double fuzz;
+    basic_color<T> albedo;
+    T fuzz;
 };
 
-class dielectric : public material {
+template <typename T>
+class basic_dielectric {
 public:
-    dielectric(double index_of_refraction) : ir(index_of_refraction) {}
+    basic_dielectric(T index_of_refraction) : ir(index_of_refraction) {}
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
-        attenuation = color(1.0, 1.0, 1.0);
-        double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
+    bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_color<T>& attenuation, basic_ray<T>& scattered,
+        basic_sampler<T>& sampler) const {
+        attenuation = basic_color<T>(1, 1, 1);
+        T refraction_ratio = rec.front_face ? (1 / ir) : ir;
 
-        vec3 unit_direction = unit_vector(r_in.direction());
-        double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
-        double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+        basic_vec3<T> unit_direction = unit_vector(r_in.direction());
+        T cos_theta = fmin(dot(-unit_direction, rec.normal), T(1));
+        T sin_theta = sqrt(1 - cos_theta * cos_theta);
 
-        bool cannot_refract = refraction_ratio * sin_theta > 1.0;
-        vec3 direction;
-        if (cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double())
+        bool cannot_refract = refraction_ratio * sin_theta > 1;
+        basic_vec3<T> direction;
+        if (cannot_refract || reflectance(cos_theta, refraction_ratio) > sampler.get_1d())
             direction = reflect(unit_direction, rec.normal);
         else
             direction = refract(unit_direction, rec.normal, refraction_ratio);
 
-        scattered = ray(rec.p, direction);
+        scattered = basic_ray<T>(rec.p, direction);
         return true;
     }
 
 private:
-    double ir; // Index of Refraction
+    T ir; // Index of Refraction
 
-    static double reflectance(double cosine, double ref_idx) {
+    static T reflectance(T cosine, T ref_idx) {
         // Use Schlick's approximation for reflectance.
         auto r0 = (1 - ref_idx) / (1 + ref_idx);
         r0 = r0 * r0;
-        return r0 + (1 - r0) * pow((1 - cosine), 5);
+        return r0 + (1 - r0) * std::pow((1 - cosine), T(5));
+    }
+};
+
+// An emitter: it gives off `emit` from both sides and absorbs whatever reaches it.
+template <typename T>
+class basic_diffuse_light {
+public:
+    basic_diffuse_light(const basic_color<T>& emit) : emit(emit) {}
+
+    bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_color<T>& attenuation, basic_ray<T>& scattered,
+        basic_sampler<T>& sampler) const {
+        return false;
+    }
+
+    const basic_color<T>& emitted() const { return emit; }
+
+private:
+    basic_color<T> emit;
+};
+
+template <typename T> class basic_textured;
+
+// A material is one of the concrete kinds above, stored by value so scatter() dispatches with a
+// switch on the variant index instead of a virtual call.
+template <typename T>
+using basic_material = std::variant<basic_lambertian<T>, basic_metal<T>, basic_dielectric<T>, basic_diffuse_light<T>, basic_textured<T>>;
+
+// A surface whose color, roughness and shading normal vary across it, read from image textures
+// (see Texture.h) at the hit's texture coordinates. Each hit stands in for one of the kinds above:
+// metal with fuzz equal to the roughness, picked with probability 1 - roughness, and lambertian
+// otherwise, so a surface without a roughness map is lambertian throughout.
+template <typename T>
+class basic_textured {
+public:
+    using texture = basic_image_texture<T>;
+
+    basic_textured(shared_ptr<const texture> albedo, shared_ptr<const texture> roughness, shared_ptr<const texture> normals)
+        : albedo_map(std::move(albedo)), roughness_map(std::move(roughness)), normal_map(std::move(normals)) {}
+
+    // Reads the textures at the hit, filtered over the footprint of the ray cone that reached it,
+    // bends rec.normal by the normal map and returns the lobe the hit scatters with.
+    basic_material<T> resolve(const basic_ray<T>& r_in, basic_hit_record<T>& rec, basic_sampler<T>& sampler) const {
+        rec.finish_uv();
+        T footprint = texture_footprint(r_in, rec);
+        basic_color<T> albedo = albedo_map->sample(rec.u, rec.v, footprint);
+        if (normal_map)
+            bend_normal(r_in, rec, normal_map->sample(rec.u, rec.v, footprint));
+
+        if (roughness_map) {
+            T roughness = std::min(std::max(roughness_map->sample(rec.u, rec.v, footprint).x(), T(0)), T(1));
+            if (sampler.get_1d() >= roughness)
+                return basic_metal<T>(albedo, roughness);
+        }
+        return basic_lambertian<T>(albedo);
+    }
+
+    // The camera resolves the lobe before scattering (see basic_material_table::resolve()); this
+    // does both at once for callers that only scatter.
+    bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_color<T>& attenuation, basic_ray<T>& scattered,
+        basic_sampler<T>& sampler) const {
+        basic_hit_record<T> bent = rec;
+        basic_material<T> lobe = resolve(r_in, bent, sampler);
+        return std::visit([&](const auto& mat) { return mat.scatter(r_in, bent, attenuation, scattered, sampler); }, lobe);
+    }
+
+private:
+    shared_ptr<const texture> albedo_map;
+    shared_ptr<const texture> roughness_map;  // Optional
+    shared_ptr<const texture> normal_map;     // Optional
+
+    static T texture_footprint(const basic_ray<T>& r_in, const basic_hit_record<T>& rec) {
+        // The cone's width in texture units: stretched by the slant at which it meets the surface
+        // and divided by the size of a texture unit there. A surface without texture coordinates
+        // has no such size and gets the texture's average.
+        T area = cross(rec.dpdu, rec.dpdv).length();
+        if (area <= 0)
+            return std::numeric_limits<T>::infinity();
+        T cosine = fabs(dot(unit_vector(r_in.direction()), rec.normal));
+        return rec.footprint / (std::max(cosine, T(0.01)) * sqrt(area));
+    }
+
+    static void bend_normal(const basic_ray<T>& r_in, basic_hit_record<T>& rec, const basic_vec3<T>& mapped) {
+        // The tangent follows u and the bitangent v, so the map's green channel points up the image.
+        basic_vec3<T> n = rec.normal;
+        basic_vec3<T> tangent = rec.dpdu - dot(rec.dpdu, n) * n;
+        if (tangent.length_squared() <= 0)
+            return;
+        tangent = unit_vector(tangent);
+        basic_vec3<T> bitangent = cross(n, tangent);
+        if (dot(bitangent, rec.dpdv) < 0)
+            bitangent = -bitangent;
+
+        basic_vec3<T> bent = mapped.x() * tangent + mapped.y() * bitangent + mapped.z() * n;
+        // A normal bent past the viewer would let light through the surface; keep the surface's own.
+        if (bent.length_squared() > 0 && dot(bent, r_in.direction()) < 0)
+            rec.normal = unit_vector(bent);
     }
 };
 
-#endif
\ No newline at end of file
+// Every material of a scene in one contiguous array. Hit records refer to entries by index, so
+// closest-hit bookkeeping never touches a reference count.
+template <typename T>
+class basic_material_table {
+public:
+    material_id add(const basic_material<T>& mat) {
+        materials.push_back(mat);
+        return static_cast<material_id>(materials.size() - 1);
+    }
+
+    size_t size() const { return materials.size(); }
+
+    const basic_material<T>& operator[](material_id id) const { return materials[id]; }
+
+    bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_color<T>& attenuation, basic_ray<T>& scattered,
+        basic_sampler<T>& sampler) const {
+        return scatter(materials[rec.mat], r_in, rec, attenuation, scattered, sampler);
+    }
+
+    static bool scatter(const basic_material<T>& material, const basic_ray<T>& r_in, const basic_hit_record<T>& rec,
+        basic_color<T>& attenuation, basic_ray<T>& scattered, basic_sampler<T>& sampler) {
+        return std::visit([&](const auto& mat) { return mat.scatter(r_in, rec, attenuation, scattered, sampler); }, material);
+    }
+
+    bool textured(material_id id) const { return std::holds_alternative<basic_textured<T>>(materials[id]); }
+
+    // For a textured material, reads its textures at the hit and bends rec.normal, and returns
+    // the material that stands in for it there (see basic_textured).
+    basic_material<T> resolve(const basic_ray<T>& r_in, basic_hit_record<T>& rec, basic_sampler<T>& sampler) const {
+        return std::get<basic_textured<T>>(materials[rec.mat]).resolve(r_in, rec, sampler);
+    }
+
+    // Radiance given off by the material; black for everything but emitters.
+    basic_color<T> emitted(material_id id) const {
+        auto light = std::get_if<basic_diffuse_light<T>>(&materials[id]);
+        return light != nullptr ? light->emitted() : basic_color<T>(0, 0, 0);
+    }
+
+    // True for materials whose scatter() samples a cosine-weighted Lambertian lobe, with their
+    // reflectance in `albedo`. Only these have a density that lights can be sampled against.
+    bool diffuse(material_id id, basic_color<T>& albedo) const { return diffuse(materials[id], albedo); }
+
+    static bool diffuse(const basic_material<T>& mat, basic_color<T>& albedo) {
+        auto surface = std::get_if<basic_lambertian<T>>(&mat);
+        if (surface == nullptr)
+            return false;
+        albedo = surface->reflectance();
+        return true;
+    }
+
+    // The surface color a denoiser is guided by: the reflectance, or the emission clipped to 1
+    // for a light. False for glass and nearly smooth metal, which show what they reflect rather
+    // than a color of their own, so the guide is better taken further along the path.
+    bool guide(material_id id, basic_color<T>& albedo) const { return guide(materials[id], albedo); }
+
+    static bool guide(const basic_material<T>& mat, basic_color<T>& albedo) {
+        if (auto surface = std::get_if<basic_lambertian<T>>(&mat)) {
+            albedo = surface->reflectance();
+            return true;
+        }
+        if (auto surface = std::get_if<basic_metal<T>>(&mat)) {
+            albedo = surface->reflectance();
+            return surface->roughness() >= T(0.25);
+        }
+        if (auto light = std::get_if<basic_diffuse_light<T>>(&mat)) {
+            const basic_color<T>& e = light->emitted();
+            albedo = basic_color<T>(std::min(e.x(), T(1)), std::min(e.y(), T(1)), std::min(e.z(), T(1)));
+            return true;
+        }
+        albedo = basic_color<T>(1, 1, 1);
+        return false;
+    }
+
+    // How much a bounce off the material widens a ray cone, in radians: not at all for mirrors
+    // and glass, by the fuzz for metal and by about the core of the cosine lobe for diffuse
+    // surfaces, whose next hits are then read from coarse texture levels.
+    static T spread(const basic_material<T>& mat) {
+        if (std::holds_alternative<basic_lambertian<T>>(mat))
+            return 1;
+        if (auto surface = std::get_if<basic_metal<T>>(&mat))
+            return surface->roughness();
+        return 0;
+    }
+
+private:
+    std::vector<basic_material<T>> materials;
+};
+
+using material = basic_material<double>;
+using lambertian = basic_lambertian<double>;
+using metal = basic_metal<double>;
+using dielectric = basic_dielectric<double>;
+using diffuse_light = basic_diffuse_light<double>;
+using textured = basic_textured<double>;
+using material_table = basic_material_table<double>;
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "rtweekend.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Triangle geometry with shared vertices: every three entries of `indices` form a triangle.
+// `normals` is either empty or holds one normal per vertex, and `uvs` either empty or a pair of
+// texture coordinates per vertex.
+template <typename T>
+struct basic_mesh_data {
+    std::vector<basic_point3<T>> positions;
+    std::vector<basic_vec3<T>> normals;
+    std::vector<T> uvs;
+    std::vector<uint32_t> indices;
+
+    size_t triangle_count() const { return indices.size() / 3; }
+};
+
+// Loads the triangles of a Wavefront OBJ file. Faces may be v, v/vt, v//vn or v/vt/vn, with
+// negative (relative) indices, and polygons are split into fans. Corners that share a position,
+// texture coordinates and a normal become one shared vertex. Unlike the DX11 loader the file's
+// right-handed coordinates and winding are kept as they are.
+template <typename T>
+bool load_obj(const std::string& path, basic_mesh_data<T>& mesh) {
+    std::ifstream obj(path);
+    if (!obj.is_open()) {
+        std::cerr << "Could not open OBJ file '" << path << "'\n";
+        return false;
+    }
+
+    mesh = basic_mesh_data<T>();
+    std::vector<basic_point3<T>> file_positions;
+    std::vector<basic_vec3<T>> file_normals;
+    std::vector<T> file_uvs;
+
+    struct corner {
+        long position, uv, normal;
+        bool operator==(const corner& other) const {
+            return position == other.position && uv == other.uv && normal == other.normal;
+        }
+    };
+    struct corner_hash {
+        size_t operator()(const corner& c) const {
+            uint64_t h = static_cast<uint64_t>(c.position) * 0x9e3779b97f4a7c15ull;
+            h ^= static_cast<uint64_t>(c.uv) * 0xc2b2ae3d27d4eb4full + (h << 6) + (h >> 2);
+            h ^= static_cast<uint64_t>(c.normal) * 0x165667b19e3779f9ull + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h);
+        }
+    };
+    std::unordered_map<corner, uint32_t, corner_hash> vertex_lookup;
+    std::vector<uint32_t> face;
+    bool all_have_normals = true;
+    bool all_have_uvs = true;
+
+    // Resolves a 1-based or negative OBJ index against the current element count; -1 if invalid.
+    auto resolve = [](long index, size_t count) -> long {
+        long resolved = index > 0 ? index - 1 : static_cast<long>(count) + index;
+        return (index == 0 || resolved < 0 || resolved >= static_cast<long>(count)) ? -1 : resolved;
+    };
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(obj, line)) {
+        ++line_number;
+        const char* c = line.c_str();
+        while (*c == ' ' || *c == '\t')
+            ++c;
+
+        if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t')) {
+            char* end;
+            double x = strtod(c + 2, &end);
+            double y = strtod(end, &end);
+            double z = strtod(end, &end);
+            file_positions.push_back(basic_point3<T>(static_cast<T>(x), static_cast<T>(y), static_cast<T>(z)));
+        }
+        else if (c[0] == 'v' && c[1] == 'n') {
+            char* end;
+            double x = strtod(c + 2, &end);
+            double y = strtod(end, &end);
+            double z = strtod(end, &end);
+            file_normals.push_back(unit_vector(basic_vec3<T>(static_cast<T>(x), static_cast<T>(y), static_cast<T>(z))));
+        }
+        else if (c[0] == 'v' && c[1] == 't') {
+            char* end;
+            double u = strtod(c + 2, &end);
+            double v = strtod(end, &end);
+            file_uvs.push_back(static_cast<T>(u));
+            file_uvs.push_back(static_cast<T>(v));
+        }
+        else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t')) {
+            face.clear();
+            const char* p = c + 2;
+            char* end;
+            while (true) {
+                while (*p == ' ' || *p == '\t' || *p == '\r')
+                    ++p;
+                if (*p == '\0')
+                    break;
+
+                long position = resolve(strtol(p, &end, 10), file_positions.size());
+                p = end;
+                long uv = -1;
+                long normal = -1;
+                if (*p == '/') {
+                    ++p;
+                    if (*p != '/') {
+                        uv = resolve(strtol(p, &end, 10), file_uvs.size() / 2);
+                        p = end;
+                    }
+                    if (*p == '/') {
+                        ++p;
+                        normal = resolve(strtol(p, &end, 10), file_normals.size());
+                        p = end;
+                    }
+                }
+                if (position < 0) {
+                    std::cerr << path << ":" << line_number << ": face references a missing vertex\n";
+                    return false;
+                }
+                while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r')
+                    ++p;
+
+                if (normal < 0)
+                    all_have_normals = false;
+                if (uv < 0)
+                    all_have_uvs = false;
+                corner key = { position, uv, normal };
+                auto found = vertex_lookup.find(key);
+                if (found == vertex_lookup.end()) {
+                    auto vertex = static_cast<uint32_t>(mesh.positions.size());
+                    mesh.positions.push_back(file_positions[position]);
+                    mesh.normals.push_back(normal < 0 ? basic_vec3<T>() : file_normals[normal]);
+                    mesh.uvs.push_back(uv < 0 ? 0 : file_uvs[uv * 2]);
+                    mesh.uvs.push_back(uv < 0 ? 0 : file_uvs[uv * 2 + 1]);
+                    found = vertex_lookup.emplace(key, vertex).first;
+                }
+                face.push_back(found->second);
+            }
+
+            for (size_t i = 2; i < face.size(); ++i) {
+                mesh.indices.push_back(face[0]);
+                mesh.indices.push_back(face[i - 1]);
+                mesh.indices.push_back(face[i]);
+            }
+        }
+    }
+
+    // Shading normals are all or nothing; a partly specified mesh falls back to flat shading.
+    // The same goes for texture coordinates.
+    if (!all_have_normals)
+        mesh.normals.clear();
+    if (!all_have_uvs)
+        mesh.uvs.clear();
+
+    return true;
+}
+
+using mesh_data = basic_mesh_data<double>;
+
+#endif
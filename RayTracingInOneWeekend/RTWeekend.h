@@ -5,7 +5,8 @@
 #include <cstdlib>
 #include <limits>
 #include <memory>
-#include <random> // newer
+
+#include "Random.h"
 
 
 // Usings
@@ -13,6 +14,9 @@
 using std::shared_ptr;
 using std::make_shared;
 using std::sqrt;
+using std::fabs;
+using std::fmin;
+using std::fmax;
 
 // Constants
 
@@ -21,19 +25,24 @@ const double pi = 3.1415926535897932385;
 
 // Utility Functions
 
-inline double degrees_to_radians(double degrees) {
-    return degrees * pi / 180.0;
+template <typename T>
+inline T degrees_to_radians(T degrees) {
+    return degrees * static_cast<T>(pi) / 180;
+}
+
+inline pcg32& random_generator() {
+    // Each thread draws from its own generator so pixels can render in parallel.
+    thread_local pcg32 generator;
+    return generator;
 }
 
-inline double newer_random_double() {
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
+inline void seed_random(uint64_t seed, uint64_t stream = 0) {
+    random_generator().seed(hash_seed(seed, stream), stream);
 }
 
 inline double random_double() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    return random_generator().next_double();
 }
 
 inline double random_double(double min, double max) {
@@ -41,6 +50,16 @@ inline double random_double(double min, double max) {
     return min + (max - min) * random_double();
 }
 
+// Scalar-typed versions for the templated math; float draws never round up to 1.
+template <typename T> inline T random_real();
+template <> inline double random_real<double>() { return random_double(); }
+template <> inline float random_real<float>() { return random_generator().next_float(); }
+
+template <typename T>
+inline T random_real(T min, T max) {
+    return min + (max - min) * random_real<T>();
+}
+
 // Common Headers
 
 #include "Ray.h"
@@ -3,22 +3,25 @@
 
 #include "Vec3.h"
 
-class ray {
+template <typename T>
+class basic_ray {
 public:
-    ray() {}
+    basic_ray() {}
 
-    ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction) {}
+    basic_ray(const basic_point3<T>& origin, const basic_vec3<T>& direction) : orig(origin), dir(direction) {}
 
-    point3 origin() const { return orig; }
-    vec3 direction() const { return dir; }
+    basic_point3<T> origin() const { return orig; }
+    basic_vec3<T> direction() const { return dir; }
 
-    point3 at(double t) const {
+    basic_point3<T> at(T t) const {
         return orig + t * dir;
     }
 
 private:
-    point3 orig;
-    vec3 dir;
+    basic_point3<T> orig;
+    basic_vec3<T> dir;
 };
 
-#endif
\ No newline at end of file
+using ray = basic_ray<double>;
+
+#endif
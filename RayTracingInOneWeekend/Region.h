@@ -0,0 +1,234 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include "ImageOutput.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// Distributed rendering splits a frame between processes by rows of tiles: region `index` of
+// `count` owns tile rows index, index + count, index + 2 * count, ... Interleaving spreads cheap
+// rows (sky) and expensive ones evenly. Every sample is seeded from the pixel and sample index
+// alone, so a pixel comes out the same whichever process renders it, and the merged frame is
+// bit-identical to a single-process render.
+//
+// A worker writes its rows as a region buffer: a header followed by linear RGB floats for each of
+// its tile rows, top to bottom, in native byte order. The file can go to a shared directory or
+// down a pipe to the coordinator.
+class region_buffer {
+public:
+    int width = 0, height = 0, tile_size = 0;
+    int index = 0, count = 1;
+    uint64_t primary_rays = 0, secondary_rays = 0;
+    double seconds = 0;
+    std::vector<float> rgb;  // The region's tile rows, top to bottom
+
+    bool owns_tile_row(int tile_row) const { return tile_row % count == index; }
+
+    // Writes the buffer to `path`, or to stdout when the path is "-".
+    bool save(const std::string& path) const {
+        bool to_stdout = path == "-";
+        FILE* file = stdout;
+        if (to_stdout) {
+#if defined(_WIN32)
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        }
+        else {
+            file = fopen(path.c_str(), "wb");
+            if (file == NULL) {
+                std::cerr << "Could not open '" << path << "' for writing\n";
+                return false;
+            }
+        }
+
+        header h = {};
+        memcpy(h.magic, "RTREGN1", 8);
+        h.primary_rays = primary_rays;
+        h.secondary_rays = secondary_rays;
+        h.seconds = seconds;
+        h.width = width;
+        h.height = height;
+        h.tile_size = tile_size;
+        h.index = index;
+        h.count = count;
+        fwrite(&h, sizeof(h), 1, file);
+        fwrite(rgb.data(), sizeof(float), rgb.size(), file);
+
+        bool ok = fflush(file) == 0 && ferror(file) == 0;
+        if (!to_stdout)
+            ok = fclose(file) == 0 && ok;
+        if (!ok)
+            std::cerr << "Failed to write region " << index << " to '" << path << "'\n";
+        return ok;
+    }
+
+    // Reads a buffer written by save(); `name` only labels error messages.
+    bool load(FILE* file, const std::string& name) {
+        header h;
+        if (fread(&h, sizeof(h), 1, file) != 1 || memcmp(h.magic, "RTREGN1", 8) != 0) {
+            std::cerr << "'" << name << "' is not a region buffer\n";
+            return false;
+        }
+        if (h.width <= 0 || h.height <= 0 || h.tile_size <= 0 || h.count <= 0 || h.index < 0 || h.index >= h.count) {
+            std::cerr << "'" << name << "' has an invalid region header\n";
+            return false;
+        }
+
+        width = h.width;
+        height = h.height;
+        tile_size = h.tile_size;
+        index = h.index;
+        count = h.count;
+        primary_rays = h.primary_rays;
+        secondary_rays = h.secondary_rays;
+        seconds = h.seconds;
+
+        rgb.resize(static_cast<size_t>(row_count()) * width * 3);
+        if (fread(rgb.data(), sizeof(float), rgb.size(), file) != rgb.size()) {
+            std::cerr << "'" << name << "' is truncated\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool load(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == NULL) {
+            std::cerr << "Could not open region buffer '" << path << "'\n";
+            return false;
+        }
+        bool ok = load(file, path);
+        fclose(file);
+        return ok;
+    }
+
+    // Image rows the region owns.
+    int row_count() const {
+        int rows = 0;
+        for (int y = 0; y < height; y += tile_size) {
+            if (owns_tile_row(y / tile_size))
+                rows += std::min(tile_size, height - y);
+        }
+        return rows;
+    }
+
+private:
+    struct header {
+        char     magic[8];  // "RTREGN1" and a terminating zero
+        uint64_t primary_rays;
+        uint64_t secondary_rays;
+        double   seconds;   // Render time of this region's process
+        int32_t  width, height;
+        int32_t  tile_size;
+        int32_t  index, count;
+        int32_t  reserved;
+    };
+};
+
+// Stitches one buffer of every region of a frame back together and writes the image. The
+// buffers may arrive in any order.
+inline bool merge_regions(const std::vector<region_buffer>& regions, const std::string& output_path) {
+    if (regions.empty())
+        return false;
+
+    const region_buffer& first = regions[0];
+    std::vector<const region_buffer*> by_index(first.count, nullptr);
+    for (const auto& region : regions) {
+        if (region.width != first.width || region.height != first.height || region.tile_size != first.tile_size
+            || region.count != first.count) {
+            std::cerr << "Region " << region.index << " belongs to a different frame\n";
+            return false;
+        }
+        if (by_index[region.index] != nullptr) {
+            std::cerr << "Region " << region.index << " was given twice\n";
+            return false;
+        }
+        by_index[region.index] = &region;
+    }
+    for (int i = 0; i < first.count; ++i) {
+        if (by_index[i] == nullptr) {
+            std::cerr << "Region " << i << " of " << first.count << " is missing\n";
+            return false;
+        }
+    }
+
+    image_output output;
+    if (!output.open(output_path, first.width, first.height))
+        return false;
+
+    std::vector<size_t> offsets(first.count, 0);
+    for (int y = 0; y < first.height; y += first.tile_size) {
+        int tile_row = y / first.tile_size;
+        int rows = std::min(first.tile_size, first.height - y);
+        int owner = tile_row % first.count;
+        output.write_rows(rows, &by_index[owner]->rgb[offsets[owner]]);
+        offsets[owner] += static_cast<size_t>(rows) * first.width * 3;
+    }
+    return output.close();
+}
+
+// Renders a frame with `count` worker processes connected by pipes and writes the merged image.
+// Each worker is started as `worker_command <index> <count>` and must write its region buffer to
+// stdout. The command goes through the shell, so it can just as well reach another machine, e.g.
+// "ssh render-02 /opt/rt/RayTracingInOneWeekend --region".
+inline bool render_distributed(const std::string& worker_command, int count, const std::string& output_path) {
+#if defined(_WIN32)
+    auto open_pipe = [](const std::string& command) { return _popen(command.c_str(), "rb"); };
+    auto close_pipe = [](FILE* pipe) { return _pclose(pipe); };
+#else
+    auto open_pipe = [](const std::string& command) { return popen(command.c_str(), "r"); };
+    auto close_pipe = [](FILE* pipe) { return pclose(pipe); };
+#endif
+
+    // Start every worker before reading from any. A worker writes its buffer only once it has
+    // finished rendering, so reading them one after another never holds the others up.
+    std::vector<FILE*> pipes(count, nullptr);
+    bool ok = true;
+    for (int i = 0; i < count && ok; ++i) {
+        std::string command = worker_command + " " + std::to_string(i) + " " + std::to_string(count);
+        pipes[i] = open_pipe(command);
+        if (pipes[i] == NULL) {
+            std::cerr << "Could not start worker '" << command << "'\n";
+            ok = false;
+        }
+    }
+
+    std::vector<region_buffer> regions(count);
+    for (int i = 0; i < count; ++i) {
+        if (pipes[i] == NULL)
+            continue;
+        std::string name = "worker " + std::to_string(i);
+        ok = regions[i].load(pipes[i], name) && ok;
+        if (close_pipe(pipes[i]) != 0) {
+            std::cerr << "Worker " << i << " failed\n";
+            ok = false;
+        }
+    }
+    if (!ok)
+        return false;
+
+    uint64_t primary_rays = 0, secondary_rays = 0;
+    double slowest = 0;
+    for (const auto& region : regions) {
+        primary_rays += region.primary_rays;
+        secondary_rays += region.secondary_rays;
+        slowest = std::max(slowest, region.seconds);
+    }
+    std::clog << count << " workers, " << primary_rays << " primary and " << secondary_rays << " secondary rays, "
+        << "slowest worker " << slowest << " s\n";
+
+    return merge_regions(regions, output_path);
+}
+
+#endif
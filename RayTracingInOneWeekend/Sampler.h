@@ -0,0 +1,334 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// How the random numbers of a pixel's samples are placed.
+enum class sampler_type {
+    independent,  // Uniform random numbers from the sample's own stream, as in the book
+    stratified,   // Correlated multi-jittered: each dimension is jittered over one stratum per sample
+    sobol,        // Owen-scrambled Sobol points, scrambled afresh for every pixel
+    blue_noise    // One Owen-scrambled Sobol sequence for all pixels, shifted per pixel by a blue-noise tile
+};
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+// The second dimension of the Sobol sequence; the first is just reverse_bits(index). Together
+// they are a (0,2)-sequence: every power-of-two prefix is stratified in every elementary interval.
+inline uint32_t sobol_second_dimension(uint32_t index) {
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+        if (index & 1)
+            result ^= v;
+    }
+    return result;
+}
+
+// Hash-based Owen scrambling (Burley 2020, "Practical Hash-based Owen Scrambling"): a random
+// permutation of every subtree of the binary digits, cheap enough to run per sample.
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits(x);
+}
+
+// A pseudo-random permutation of [0, count) chosen by `seed` (Kensler 2013, "Correlated
+// Multi-Jittered Sampling").
+inline uint32_t permute_index(uint32_t i, uint32_t count, uint32_t seed) {
+    uint32_t w = count - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= seed;
+        i *= 0xe170893du;
+        i ^= seed >> 16;
+        i ^= (i & w) >> 4;
+        i ^= seed >> 8;
+        i *= 0x0929eb3fu;
+        i ^= seed >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | seed >> 27;
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= count);
+    return (i + seed) % count;
+}
+
+// A hashed random number in [0,1) for index `i` (Kensler 2013).
+inline double hashed_unit(uint32_t i, uint32_t seed) {
+    i ^= seed;
+    i ^= i >> 17;
+    i ^= i >> 10;
+    i *= 0xb36534e5u;
+    i ^= i >> 12;
+    i ^= i >> 21;
+    i *= 0x93fc4795u;
+    i ^= 0xdf6e307fu;
+    i ^= i >> 17;
+    i *= 1 | seed >> 18;
+    return i * (1.0 / 4294967296.0);
+}
+
+const int blue_noise_size = 64;  // Side of the square blue-noise tile in pixels
+
+inline std::vector<uint16_t> make_blue_noise_ranks() {
+    // Void-and-cluster (Ulichney 1993) on a torus: ranks every texel of the tile so that the
+    // texels below any threshold are spread as evenly as possible.
+    const int n = blue_noise_size, count = n * n;
+    const double sigma = 1.5;
+    std::vector<double> kernel(count);
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            int dx = std::min(x, n - x), dy = std::min(y, n - y);
+            kernel[y * n + x] = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+        }
+    }
+
+    std::vector<char> on(count, 0);
+    std::vector<double> energy(count, 0);
+    auto toggle = [&](int p, bool set) {
+        on[p] = set;
+        int px = p % n, py = p / n;
+        double sign = set ? 1 : -1;
+        for (int y = 0; y < n; y++) {
+            const double* row = &kernel[((y - py + n) % n) * n];
+            for (int x = 0; x < n; x++)
+                energy[y * n + x] += sign * row[(x - px + n) % n];
+        }
+    };
+    auto tightest_cluster = [&]() {
+        int best = -1;
+        for (int p = 0; p < count; p++) {
+            if (on[p] && (best < 0 || energy[p] > energy[best]))
+                best = p;
+        }
+        return best;
+    };
+    auto largest_void = [&]() {
+        int best = -1;
+        for (int p = 0; p < count; p++) {
+            if (!on[p] && (best < 0 || energy[p] < energy[best]))
+                best = p;
+        }
+        return best;
+    };
+
+    // A random tenth of the texels, relaxed by moving the tightest cluster into the largest void
+    // until that changes nothing.
+    pcg32 rng(0x5eed, 0xb1);
+    int initial = count / 10;
+    for (int placed = 0; placed < initial;) {
+        int p = static_cast<int>(rng.next_uint() % count);
+        if (!on[p]) {
+            toggle(p, true);
+            placed++;
+        }
+    }
+    while (true) {
+        int cluster = tightest_cluster();
+        toggle(cluster, false);
+        int gap = largest_void();
+        toggle(gap, true);
+        if (gap == cluster)
+            break;
+    }
+    auto initial_on = on;
+    auto initial_energy = energy;
+
+    std::vector<uint16_t> ranks(count);
+    for (int rank = initial - 1; rank >= 0; rank--) {
+        int cluster = tightest_cluster();
+        toggle(cluster, false);
+        ranks[cluster] = static_cast<uint16_t>(rank);
+    }
+    on = initial_on;
+    energy = initial_energy;
+    for (int rank = initial; rank < count; rank++) {
+        int gap = largest_void();
+        toggle(gap, true);
+        ranks[gap] = static_cast<uint16_t>(rank);
+    }
+    return ranks;
+}
+
+// The blue-noise tile, built on first use.
+inline const std::vector<uint16_t>& blue_noise_ranks() {
+    static const std::vector<uint16_t> ranks = make_blue_noise_ranks();
+    return ranks;
+}
+
+// Hands out the random numbers of one sample of one pixel, one dimension at a time. The camera
+// gives every decision of a path its own dimension (see basic_camera::shade()), so the low-
+// discrepancy samplers stratify the same decision across a pixel's samples.
+template <typename T>
+class basic_sampler {
+public:
+    basic_sampler() {}
+
+    basic_sampler(sampler_type type, uint64_t seed, int i, int j, int sample_index, int sample_count)
+        : type(type), seed(seed), x(i), y(j), index(static_cast<uint32_t>(sample_index)),
+        count(static_cast<uint32_t>(std::max(sample_count, 1)))
+    {
+        if (type == sampler_type::blue_noise)
+            blue_noise_ranks();
+    }
+
+    void set_dimension(int d) { dimension = d; }
+
+    T get_1d() {
+        if (type == sampler_type::independent)
+            return random_real<T>();
+
+        uint32_t s = dimension_seed();
+        ++dimension;
+        if (type == sampler_type::stratified) {
+            if (index >= count)
+                return to_unit(hashed_unit(index, s));
+            return to_unit((permute_index(index, count, s) + hashed_unit(index, s * 0x68bc21ebu)) / count);
+        }
+
+        uint32_t shuffled = nested_uniform_scramble(index, s);
+        uint32_t u = nested_uniform_scramble(reverse_bits(shuffled), s * 0x9e3779b9u);
+        if (type == sampler_type::blue_noise)
+            u += blue_noise_offset(s);
+        return to_unit(u);
+    }
+
+    void get_2d(T& u, T& v) {
+        if (type == sampler_type::independent) {
+            u = random_real<T>();
+            v = random_real<T>();
+            return;
+        }
+
+        uint32_t s = dimension_seed();
+        ++dimension;
+        if (type == sampler_type::stratified) {
+            if (index >= count) {
+                u = to_unit(hashed_unit(index, s));
+                v = to_unit(hashed_unit(index, s * 0x711ad6a5u));
+                return;
+            }
+            // A grid of m x n strata, m * n >= count, with the sample's cell in each row and
+            // column permuted so the samples are also stratified along both axes.
+            uint32_t m = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+            uint32_t n = (count + m - 1) / m;
+            uint32_t cell = permute_index(index, count, s * 0x51633e2du);
+            uint32_t sx = permute_index(cell % m, m, s * 0xa511e9b3u);
+            uint32_t sy = permute_index(cell / m, n, s * 0x63d83595u);
+            double jx = hashed_unit(cell, s * 0xa399d265u);
+            double jy = hashed_unit(cell, s * 0x711ad6a5u);
+            u = to_unit((cell % m + (sy + jx) / n) / m);
+            v = to_unit((cell / m + (sx + jy) / m) / n);
+            return;
+        }
+
+        uint32_t shuffled = nested_uniform_scramble(index, s);
+        uint32_t a = nested_uniform_scramble(reverse_bits(shuffled), s * 0x9e3779b9u);
+        uint32_t b = nested_uniform_scramble(sobol_second_dimension(shuffled), s * 0x85ebca6bu);
+        if (type == sampler_type::blue_noise) {
+            a += blue_noise_offset(s);
+            b += blue_noise_offset(s * 0xc2b2ae35u);
+        }
+        u = to_unit(a);
+        v = to_unit(b);
+    }
+
+    // A uniformly distributed direction.
+    basic_vec3<T> unit_vector() {
+        if (type == sampler_type::independent)
+            return random_unit_vector<T>();
+        T u, v;
+        get_2d(u, v);
+        T z = 1 - 2 * u;
+        T r = sqrt(std::max(T(0), 1 - z * z));
+        T phi = 2 * static_cast<T>(pi) * v;
+        return basic_vec3<T>(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    // A uniformly distributed point in the unit disk in the xy plane.
+    basic_vec3<T> in_unit_disk() {
+        if (type == sampler_type::independent)
+            return random_in_unit_disk<T>();
+        // Shirley and Chiu's concentric map keeps the square's strata compact on the disk.
+        T u, v;
+        get_2d(u, v);
+        T a = 2 * u - 1, b = 2 * v - 1;
+        if (a == 0 && b == 0)
+            return basic_vec3<T>(0, 0, 0);
+        T r, phi;
+        if (fabs(a) > fabs(b)) {
+            r = a;
+            phi = static_cast<T>(pi) / 4 * (b / a);
+        }
+        else {
+            r = b;
+            phi = static_cast<T>(pi) / 2 - static_cast<T>(pi) / 4 * (a / b);
+        }
+        return basic_vec3<T>(r * std::cos(phi), r * std::sin(phi), 0);
+    }
+
+private:
+    sampler_type type = sampler_type::independent;
+    uint64_t seed = 0;
+    int x = 0, y = 0;
+    uint32_t index = 0;
+    uint32_t count = 1;
+    int dimension = 0;
+
+    uint32_t dimension_seed() const {
+        // Blue noise shares one sequence between all pixels; the others scramble per pixel.
+        uint64_t h = hash_seed(seed, static_cast<uint64_t>(dimension));
+        if (type != sampler_type::blue_noise)
+            h = hash_seed(h, (static_cast<uint64_t>(y) << 32) | static_cast<uint32_t>(x));
+        return static_cast<uint32_t>(h);
+    }
+
+    uint32_t blue_noise_offset(uint32_t s) const {
+        // A toroidal shift of the pixel's tile texel, differently offset for each dimension, as a
+        // fraction of 2^32 so it wraps around by itself when added.
+        int tx = (x + static_cast<int>(s & 63)) & (blue_noise_size - 1);
+        int ty = (y + static_cast<int>((s >> 6) & 63)) & (blue_noise_size - 1);
+        uint32_t rank = blue_noise_ranks()[ty * blue_noise_size + tx];
+        return (rank << 20) + (1u << 19);
+    }
+
+    static T to_unit(uint32_t bits) {
+        if (sizeof(T) == sizeof(float))
+            return static_cast<T>((bits >> 8) * (1.0f / 16777216.0f));
+        return static_cast<T>(bits * (1.0 / 4294967296.0));
+    }
+
+    static T to_unit(double value) {
+        return to_unit(static_cast<uint32_t>(std::min(value * 4294967296.0, 4294967295.0)));
+    }
+};
+
+using sampler = basic_sampler<double>;
+
+#endif
@@ -0,0 +1,853 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "rtweekend.h"
+
+#include "Animation.h"
+#include "BVH.h"
+#include "camera.h"
+#include "HittableList.h"
+#include "Instance.h"
+#include "MappedFile.h"
+#include "material.h"
+#include "ObjLoader.h"
+#include "SphereSet.h"
+#include "Texture.h"
+#include "TriangleMesh.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Scenes are described either as text, meant to be written by hand, or as a binary file that
+// holds the built acceleration structures and loads without parsing or building anything.
+//
+// Text format, one statement per line, '#' starts a comment:
+//
+//   camera <setting> <value(s)> ...    any of: aspect_ratio, image_width, samples_per_pixel,
+//                                      max_depth, rr_start_depth, vfov, lookfrom x y z,
+//                                      lookat x y z, vup x y z, defocus_angle, focus_dist,
+//                                      background r g b (replaces the sky)
+//   material <name> lambertian <r> <g> <b>
+//   material <name> metal <r> <g> <b> <fuzz>
+//   material <name> dielectric <index of refraction>
+//   material <name> emissive <r> <g> <b>   radiance, may exceed 1
+//   material <name> textured <albedo.png> [roughness <file.png>] [normals <file.png>]
+//                                      image files relative to the scene file (see Texture.h);
+//                                      meshes need texture coordinates to show more than the
+//                                      texture's average color
+//   sphere <x> <y> <z> <radius> <material>
+//   mesh <name> <file.obj>             path relative to the scene file; placed by instances
+//   instance <mesh> <material> [translate <x> <y> <z>] [rotate <x> <y> <z> <degrees>]
+//                              [scale <s> | scale <x> <y> <z>] ...
+//   frames <count>                     makes the scene an animation (see Sequence.h)
+//   key <frame> camera <setting> <value(s)> ...   any of: lookfrom, lookat, vup, vfov,
+//                                      defocus_angle, focus_dist
+//   key <frame> instance <index> <transforms> ...  replaces the transform of the index-th
+//                                      instance statement, counting from 0
+//
+// Names must be defined before they are used. Instance transforms apply in the order written.
+// Keys of one instance must list the same transforms in the same order; between keys, every
+// number is blended linearly, so a key rotating by 0 degrees and one by 360 make a full turn.
+//
+// The binary form (conventionally .rtscene) is a header followed by a fixed sequence of arrays,
+// each a 64-bit byte count and then its data, starting on a 32-byte boundary, in native byte
+// order. It is memory-mapped and every array is copied straight into place, so a scene of
+// millions of primitives loads in the time it takes to read its bytes. It is specific to the
+// scalar type and SIMD width of the build that wrote it; recompile it from the text for another.
+// Textures are not part of it: it names their files relative to its own directory, and loads them
+// again.
+
+template <typename T>
+struct basic_scene_material {
+    enum kind : uint32_t { lambertian, metal, dielectric, emissive, textured };
+
+    kind type = lambertian;
+    basic_color<T> albedo;
+    T fuzz = 0;
+    T ir = 1;  // Index of refraction
+    // An emitter's radiance is kept in albedo.
+    std::string albedo_map, roughness_map, normal_map;  // Texture files; the last two may be empty
+
+    // Textures come from `textures`, which loads each file once. False if one cannot be read.
+    bool make(basic_texture_cache<T>& textures, basic_material<T>& mat) const {
+        if (type == metal)
+            mat = basic_metal<T>(albedo, fuzz);
+        else if (type == dielectric)
+            mat = basic_dielectric<T>(ir);
+        else if (type == emissive)
+            mat = basic_diffuse_light<T>(albedo);
+        else if (type == lambertian)
+            mat = basic_lambertian<T>(albedo);
+        else {
+            auto albedo_texture = textures.get(albedo_map, texel_encoding::color);
+            shared_ptr<const basic_image_texture<T>> roughness_texture, normal_texture;
+            if (!roughness_map.empty())
+                roughness_texture = textures.get(roughness_map, texel_encoding::linear);
+            if (!normal_map.empty())
+                normal_texture = textures.get(normal_map, texel_encoding::normal);
+            if (!albedo_texture || (!roughness_map.empty() && !roughness_texture) || (!normal_map.empty() && !normal_texture))
+                return false;
+            mat = basic_textured<T>(albedo_texture, roughness_texture, normal_texture);
+        }
+        return true;
+    }
+};
+
+template <typename T>
+struct basic_scene_instance {
+    uint32_t mesh;
+    material_id mat;
+    basic_transform<T> object_to_world;
+};
+
+template <typename T>
+class basic_scene {
+public:
+    basic_camera<T> cam;  // View and sampling settings from the file; everything else is left at defaults
+    std::vector<basic_scene_material<T>> material_params;
+    basic_material_table<T> materials;
+    basic_texture_cache<T> textures;                         // Every texture the materials use, each file once
+    shared_ptr<basic_sphere_bvh<T>> spheres;                 // All spheres, or null if there are none
+    std::vector<shared_ptr<basic_triangle_mesh<T>>> meshes;  // Built once, placed by instances
+    std::vector<basic_scene_instance<T>> instances;
+    basic_animation<T> animation;                            // Keyframes, if the scene is animated
+
+    // The renderable world: spheres and instances under one small top-level BVH.
+    basic_hittable_list<T> world() const {
+        basic_hittable_list<T> objects;
+        if (spheres)
+            objects.add(spheres);
+        for (const auto& inst : instances)
+            objects.add(make_shared<basic_instance<T>>(meshes[inst.mesh], inst.object_to_world, inst.mat));
+        if (objects.objects.empty())
+            return objects;
+        return basic_hittable_list<T>(make_shared<basic_bvh_node<T>>(objects));
+    }
+};
+
+const char scene_binary_magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '1' };
+const uint32_t scene_binary_version = 5;
+
+struct scene_binary_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t scalar_size;  // sizeof(T)
+    uint32_t lane_count;   // SIMD packet width the leaves are padded to
+    uint32_t reserved;
+};
+
+inline bool parse_scene_number(const std::string& token, double& value) {
+    char* end;
+    value = strtod(token.c_str(), &end);
+    return !token.empty() && *end == '\0';
+}
+
+// Resolves a file named in a scene relative to the scene file's directory, unless it is absolute.
+inline std::string scene_relative_path(const std::string& scene_path, const std::string& file) {
+    bool absolute = (!file.empty() && (file[0] == '/' || file[0] == '\\')) || (file.size() > 1 && file[1] == ':');
+    auto slash = scene_path.find_last_of("/\\");
+    if (absolute || slash == std::string::npos)
+        return file;
+    return scene_path.substr(0, slash + 1) + file;
+}
+
+// Names a file for a binary scene at `scene_path` to find with scene_relative_path(): relative to the
+// binary's directory, so the two can move together, or absolute if there is no relative route.
+inline std::string scene_binary_file_name(const std::string& scene_path, const std::string& file) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::path target = fs::absolute(file, error).lexically_normal();
+    fs::path directory = fs::absolute(scene_path, error).lexically_normal().parent_path();
+    fs::path relative = target.lexically_relative(directory);
+    return (relative.empty() ? target : relative).generic_string();
+}
+
+// Writes arrays in the binary layout.
+class scene_binary_writer {
+public:
+    explicit scene_binary_writer(FILE* f) : file(f) {}
+
+    void raw(const void* data, size_t bytes) {
+        fwrite(data, 1, bytes, file);
+        position += bytes;
+    }
+
+    void align() {
+        static const unsigned char zeros[32] = {};
+        if (position % 32 != 0)
+            raw(zeros, 32 - position % 32);
+    }
+
+    template <typename U>
+    void array(const U* data, size_t count) {
+        align();
+        uint64_t bytes = static_cast<uint64_t>(count) * sizeof(U);
+        raw(&bytes, sizeof(bytes));
+        align();
+        if (count > 0)
+            raw(data, static_cast<size_t>(bytes));
+    }
+
+    template <typename Vector>
+    void array(const Vector& v) { array(v.data(), v.size()); }
+
+private:
+    FILE* file;
+    uint64_t position = 0;
+};
+
+// Reads arrays in the binary layout out of a mapped file, with bounds checks throughout.
+class scene_binary_reader {
+public:
+    scene_binary_reader(const unsigned char* d, size_t s) : data(d), size(s) {}
+
+    bool raw(void* out, size_t bytes) {
+        if (bytes > size - position)
+            return false;
+        memcpy(out, data + position, bytes);
+        position += bytes;
+        return true;
+    }
+
+    bool align() {
+        size_t aligned = (position + 31) / 32 * 32;
+        if (aligned > size)
+            return false;
+        position = aligned;
+        return true;
+    }
+
+    template <typename Vector>
+    bool array(Vector& v) {
+        using U = typename Vector::value_type;
+        uint64_t bytes;
+        if (!align() || !raw(&bytes, sizeof(bytes)) || !align())
+            return false;
+        if (bytes % sizeof(U) != 0 || bytes > size - position)
+            return false;
+        v.resize(static_cast<size_t>(bytes / sizeof(U)));
+        return bytes == 0 || raw(v.data(), static_cast<size_t>(bytes));
+    }
+
+private:
+    const unsigned char* data;
+    size_t size;
+    size_t position = 0;
+};
+
+// A BVH from a file may only point at later nodes and at slots that exist, and no deeper than
+// bvh_max_depth, as the builder guarantees, so that a damaged file cannot send traversal out of bounds.
+template <typename T>
+bool valid_scene_bvh(const std::vector<basic_bvh_flat_node<T>>& nodes, size_t slot_count, int lane_count) {
+    std::vector<int> depth(nodes.size(), 0);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const auto& node = nodes[i];
+        if (node.count > 0) {
+            size_t padded = (static_cast<size_t>(node.count) + lane_count - 1) / lane_count * lane_count;
+            if (node.offset < 0 || node.offset % lane_count != 0 || static_cast<size_t>(node.offset) + padded > slot_count)
+                return false;
+            continue;
+        }
+
+        if (node.count < 0 || node.split_axis < 0 || node.split_axis > 2 || depth[i] >= bvh_max_depth
+            || node.offset <= static_cast<int>(i) + 1 || static_cast<size_t>(node.offset) >= nodes.size())
+            return false;
+        depth[i + 1] = depth[node.offset] = depth[i] + 1;
+    }
+    return true;
+}
+
+// Loads a text scene: parses it, loads the meshes it names and builds every BVH.
+template <typename T>
+bool load_scene_text(const std::string& path, basic_scene<T>& scene) {
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Could not open scene file '" << path << "'\n";
+        return false;
+    }
+
+    scene = basic_scene<T>();
+    std::unordered_map<std::string, material_id> material_names;
+    std::unordered_map<std::string, uint32_t> mesh_names;
+    std::vector<basic_sphere_params<T>> spheres;
+    double v[4] = { 0, 0, 0, 0 };
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        auto comment = line.find('#');
+        if (comment != std::string::npos)
+            line.resize(comment);
+
+        std::istringstream words(line);
+        std::vector<std::string> tokens;
+        for (std::string token; words >> token;)
+            tokens.push_back(token);
+        if (tokens.empty())
+            continue;
+
+        auto fail = [&](const std::string& message) {
+            std::cerr << path << ":" << line_number << ": " << message << "\n";
+            return false;
+        };
+
+        // Reads `count` numbers starting at tokens[at] and advances `at` past them.
+        size_t at = 1;
+        auto numbers = [&](int count, double* out) {
+            for (int i = 0; i < count; i++) {
+                if (at >= tokens.size() || !parse_scene_number(tokens[at], out[i]))
+                    return false;
+                ++at;
+            }
+            return true;
+        };
+        auto vec = [](const double* v) { return basic_vec3<T>(static_cast<T>(v[0]), static_cast<T>(v[1]), static_cast<T>(v[2])); };
+        auto find_material = [&](const std::string& name, material_id& id) {
+            auto found = material_names.find(name);
+            if (found == material_names.end())
+                return false;
+            id = found->second;
+            return true;
+        };
+        // Reads transform steps up to the end of the line.
+        auto transform_steps = [&](std::vector<basic_transform_step<T>>& steps) {
+            while (at < tokens.size()) {
+                const std::string& op = tokens[at++];
+                basic_transform_step<T> step;
+                v[3] = 0;
+                if (op == "translate" && numbers(3, v)) {
+                    step.type = basic_transform_step<T>::translate;
+                }
+                else if (op == "rotate" && numbers(4, v)) {
+                    step.type = basic_transform_step<T>::rotate;
+                }
+                else if (op == "scale" && numbers(1, v)) {
+                    // One factor scales uniformly; three scale each axis.
+                    step.type = basic_transform_step<T>::scale;
+                    size_t before = at;
+                    if (!numbers(2, v + 1)) {
+                        at = before;
+                        v[1] = v[2] = v[0];
+                    }
+                }
+                else {
+                    return false;
+                }
+                for (int i = 0; i < 4; i++)
+                    step.values[i] = static_cast<T>(v[i]);
+                steps.push_back(step);
+            }
+            return true;
+        };
+
+        const std::string& statement = tokens[0];
+        if (statement == "camera") {
+            auto& cam = scene.cam;
+            while (at < tokens.size()) {
+                const std::string& key = tokens[at++];
+                bool is_vector = key == "lookfrom" || key == "lookat" || key == "vup" || key == "background";
+                if (!numbers(is_vector ? 3 : 1, v))
+                    return fail("camera setting '" + key + "' needs " + (is_vector ? "three numbers" : "a number"));
+
+                if (key == "lookfrom") cam.lookfrom = vec(v);
+                else if (key == "lookat") cam.lookat = vec(v);
+                else if (key == "vup") cam.vup = vec(v);
+                else if (key == "background") {
+                    cam.background = vec(v);
+                    cam.sky = false;
+                }
+                else if (key == "aspect_ratio") cam.aspect_ratio = static_cast<T>(v[0]);
+                else if (key == "image_width") cam.image_width = static_cast<int>(v[0]);
+                else if (key == "samples_per_pixel") cam.samples_per_pixel = static_cast<int>(v[0]);
+                else if (key == "max_depth") cam.max_depth = static_cast<int>(v[0]);
+                else if (key == "rr_start_depth") cam.rr_start_depth = static_cast<int>(v[0]);
+                else if (key == "vfov") cam.vfov = static_cast<T>(v[0]);
+                else if (key == "defocus_angle") cam.defocus_angle = static_cast<T>(v[0]);
+                else if (key == "focus_dist") cam.focus_dist = static_cast<T>(v[0]);
+                else return fail("unknown camera setting '" + key + "'");
+            }
+        }
+        else if (statement == "material") {
+            if (tokens.size() < 3)
+                return fail("material needs a name and a kind");
+            basic_scene_material<T> params;
+            const std::string& kind = tokens[2];
+            at = 3;
+            if (kind == "lambertian" && numbers(3, v)) {
+                params.type = basic_scene_material<T>::lambertian;
+                params.albedo = vec(v);
+            }
+            else if (kind == "metal" && numbers(4, v)) {
+                params.type = basic_scene_material<T>::metal;
+                params.albedo = vec(v);
+                params.fuzz = static_cast<T>(v[3]);
+            }
+            else if (kind == "dielectric" && numbers(1, v)) {
+                params.type = basic_scene_material<T>::dielectric;
+                params.ir = static_cast<T>(v[0]);
+            }
+            else if (kind == "emissive" && numbers(3, v)) {
+                params.type = basic_scene_material<T>::emissive;
+                params.albedo = vec(v);
+            }
+            else if (kind == "textured" && tokens.size() % 2 == 0) {
+                params.type = basic_scene_material<T>::textured;
+                params.albedo_map = scene_relative_path(path, tokens[3]);
+                for (at = 4; at < tokens.size(); at += 2) {
+                    if (tokens[at] == "roughness")
+                        params.roughness_map = scene_relative_path(path, tokens[at + 1]);
+                    else if (tokens[at] == "normals")
+                        params.normal_map = scene_relative_path(path, tokens[at + 1]);
+                    else
+                        return fail("expected 'textured albedo.png [roughness file.png] [normals file.png]'");
+                }
+            }
+            else {
+                return fail("expected 'lambertian r g b', 'metal r g b fuzz', 'dielectric ir', 'emissive r g b' or "
+                    "'textured albedo.png [roughness file.png] [normals file.png]'");
+            }
+            basic_material<T> mat = basic_lambertian<T>(params.albedo);
+            if (!params.make(scene.textures, mat))
+                return fail("could not load the textures of material '" + tokens[1] + "'");
+            material_names[tokens[1]] = scene.materials.add(mat);
+            scene.material_params.push_back(params);
+        }
+        else if (statement == "sphere") {
+            basic_sphere_params<T> sphere;
+            if (!numbers(4, v) || at + 1 != tokens.size())
+                return fail("expected 'sphere x y z radius material'");
+            if (!find_material(tokens[at], sphere.mat))
+                return fail("unknown material '" + tokens[at] + "'");
+            sphere.center = vec(v);
+            sphere.radius = static_cast<T>(v[3]);
+            spheres.push_back(sphere);
+        }
+        else if (statement == "mesh") {
+            if (tokens.size() != 3)
+                return fail("expected 'mesh name file.obj'");
+            basic_mesh_data<T> data;
+            if (!load_obj(scene_relative_path(path, tokens[2]), data))
+                return fail("could not load mesh '" + tokens[1] + "'");
+            mesh_names[tokens[1]] = static_cast<uint32_t>(scene.meshes.size());
+            scene.meshes.push_back(make_shared<basic_triangle_mesh<T>>(data, 0));
+        }
+        else if (statement == "instance") {
+            if (tokens.size() < 3)
+                return fail("expected 'instance mesh material [transforms]'");
+            basic_scene_instance<T> inst;
+            auto mesh = mesh_names.find(tokens[1]);
+            if (mesh == mesh_names.end())
+                return fail("unknown mesh '" + tokens[1] + "'");
+            inst.mesh = mesh->second;
+            if (!find_material(tokens[2], inst.mat))
+                return fail("unknown material '" + tokens[2] + "'");
+
+            at = 3;
+            std::vector<basic_transform_step<T>> steps;
+            if (!transform_steps(steps))
+                return fail("expected 'translate x y z', 'rotate x y z degrees' or 'scale s' / 'scale x y z'");
+            inst.object_to_world = basic_transform_step<T>::compose(steps);
+            if (inst.object_to_world.determinant() == 0)
+                return fail("instance transform is singular");
+            scene.instances.push_back(inst);
+        }
+        else if (statement == "frames") {
+            if (!numbers(1, v) || at != tokens.size() || v[0] < 1)
+                return fail("expected 'frames count'");
+            scene.animation.frame_count = static_cast<int>(v[0]);
+        }
+        else if (statement == "key") {
+            if (!numbers(1, v) || at >= tokens.size())
+                return fail("expected 'key frame camera ...' or 'key frame instance index ...'");
+            int frame = static_cast<int>(v[0]);
+            const std::string& target = tokens[at++];
+            if (target == "camera") {
+                while (at < tokens.size()) {
+                    const std::string& key = tokens[at++];
+                    basic_camera_key<T> ck;
+                    ck.frame = frame;
+                    bool is_vector = true;
+                    if (key == "lookfrom") ck.which = basic_camera_key<T>::lookfrom;
+                    else if (key == "lookat") ck.which = basic_camera_key<T>::lookat;
+                    else if (key == "vup") ck.which = basic_camera_key<T>::vup;
+                    else {
+                        is_vector = false;
+                        if (key == "vfov") ck.which = basic_camera_key<T>::vfov;
+                        else if (key == "defocus_angle") ck.which = basic_camera_key<T>::defocus_angle;
+                        else if (key == "focus_dist") ck.which = basic_camera_key<T>::focus_dist;
+                        else return fail("camera setting '" + key + "' cannot be keyed");
+                    }
+                    v[1] = v[2] = 0;
+                    if (!numbers(is_vector ? 3 : 1, v))
+                        return fail("camera setting '" + key + "' needs " + (is_vector ? "three numbers" : "a number"));
+                    ck.value = vec(v);
+                    scene.animation.camera_keys.push_back(ck);
+                }
+            }
+            else if (target == "instance") {
+                basic_instance_key<T> ik;
+                ik.frame = frame;
+                if (!numbers(1, v) || v[0] < 0)
+                    return fail("expected an instance index");
+                ik.instance = static_cast<uint32_t>(v[0]);
+                if (!transform_steps(ik.steps))
+                    return fail("expected 'translate x y z', 'rotate x y z degrees' or 'scale s' / 'scale x y z'");
+                if (basic_transform_step<T>::compose(ik.steps).determinant() == 0)
+                    return fail("instance transform is singular");
+                scene.animation.instance_keys.push_back(ik);
+            }
+            else {
+                return fail("expected 'camera' or 'instance' after the key's frame");
+            }
+        }
+        else {
+            return fail("unknown statement '" + statement + "', expected camera, material, sphere, mesh, instance, frames or key");
+        }
+    }
+
+    std::string problem = scene.animation.validate(scene.instances.size());
+    if (!problem.empty()) {
+        std::cerr << path << ": " << problem << "\n";
+        return false;
+    }
+
+    if (!spheres.empty())
+        scene.spheres = make_shared<basic_sphere_bvh<T>>(spheres);
+    return true;
+}
+
+// Writes a scene, including its built BVHs, in the binary form.
+template <typename T>
+bool save_scene_binary(const std::string& path, const basic_scene<T>& scene) {
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+        std::cerr << "Could not open '" << path << "' for writing\n";
+        return false;
+    }
+    scene_binary_writer out(file);
+
+    scene_binary_header header = {};
+    memcpy(header.magic, scene_binary_magic, sizeof(scene_binary_magic));
+    header.version = scene_binary_version;
+    header.scalar_size = sizeof(T);
+    header.lane_count = simd_packet<T>::width;
+    out.raw(&header, sizeof(header));
+
+    const auto& cam = scene.cam;
+    const T camera_reals[] = {
+        cam.aspect_ratio, cam.vfov, cam.defocus_angle, cam.focus_dist,
+        cam.lookfrom.x(), cam.lookfrom.y(), cam.lookfrom.z(), cam.lookat.x(), cam.lookat.y(), cam.lookat.z(),
+        cam.vup.x(), cam.vup.y(), cam.vup.z(), cam.background.x(), cam.background.y(), cam.background.z()
+    };
+    const int32_t camera_ints[] = { cam.image_width, cam.samples_per_pixel, cam.max_depth, cam.rr_start_depth, cam.sky ? 1 : 0 };
+    out.array(camera_reals, 16);
+    out.array(camera_ints, 5);
+
+    // Texture files follow the numbers, three zero-terminated names per material, empty for none.
+    std::vector<uint32_t> material_kinds;
+    std::vector<T> material_values;
+    std::vector<char> material_files;
+    for (const auto& m : scene.material_params) {
+        material_kinds.push_back(m.type);
+        const T values[] = { m.albedo.x(), m.albedo.y(), m.albedo.z(), m.fuzz, m.ir };
+        material_values.insert(material_values.end(), values, values + 5);
+        for (const std::string* name : { &m.albedo_map, &m.roughness_map, &m.normal_map }) {
+            std::string file = name->empty() ? *name : scene_binary_file_name(path, *name);
+            material_files.insert(material_files.end(), file.c_str(), file.c_str() + file.size() + 1);
+        }
+    }
+    out.array(material_kinds);
+    out.array(material_values);
+    out.array(material_files);
+
+    typename basic_sphere_bvh<T>::packed_data no_spheres;
+    const auto& spheres = scene.spheres ? scene.spheres->packed() : no_spheres;
+    out.array(spheres.nodes);
+    out.array(spheres.center_x);
+    out.array(spheres.center_y);
+    out.array(spheres.center_z);
+    out.array(spheres.radii);
+    out.array(spheres.material_ids);
+
+    uint64_t mesh_count = scene.meshes.size();
+    out.array(&mesh_count, 1);
+    for (const auto& mesh : scene.meshes) {
+        const auto& data = mesh->mesh_data();
+        out.array(data.positions);
+        out.array(data.normals);
+        out.array(data.uvs);
+        out.array(data.indices);
+        out.array(mesh->bvh_nodes());
+        out.array(mesh->slots());
+    }
+
+    std::vector<uint32_t> instance_ids;
+    std::vector<T> instance_transforms;
+    for (const auto& inst : scene.instances) {
+        instance_ids.push_back(inst.mesh);
+        instance_ids.push_back(inst.mat);
+        const auto& xf = inst.object_to_world;
+        for (int i = 0; i < 3; i++) {
+            instance_transforms.insert(instance_transforms.end(), xf.m[i], xf.m[i] + 3);
+            instance_transforms.push_back(xf.offset[i]);
+        }
+    }
+    out.array(instance_ids);
+    out.array(instance_transforms);
+
+    // Keys: the frame count, then camera keys as frame and setting pairs with three values each,
+    // then instance keys as (instance, frame, step count) triples followed by all their steps.
+    const auto& anim = scene.animation;
+    int32_t frame_count = anim.frame_count;
+    std::vector<int32_t> camera_key_ids;
+    std::vector<T> camera_key_values;
+    for (const auto& key : anim.camera_keys) {
+        camera_key_ids.push_back(key.frame);
+        camera_key_ids.push_back(static_cast<int32_t>(key.which));
+        camera_key_values.insert(camera_key_values.end(), { key.value.x(), key.value.y(), key.value.z() });
+    }
+    std::vector<int32_t> instance_key_ids;
+    std::vector<uint32_t> step_kinds;
+    std::vector<T> step_values;
+    for (const auto& key : anim.instance_keys) {
+        instance_key_ids.insert(instance_key_ids.end(), {
+            static_cast<int32_t>(key.instance), key.frame, static_cast<int32_t>(key.steps.size()) });
+        for (const auto& step : key.steps) {
+            step_kinds.push_back(step.type);
+            step_values.insert(step_values.end(), step.values, step.values + 4);
+        }
+    }
+    out.array(&frame_count, 1);
+    out.array(camera_key_ids);
+    out.array(camera_key_values);
+    out.array(instance_key_ids);
+    out.array(step_kinds);
+    out.array(step_values);
+
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        std::cerr << "Failed to write '" << path << "'\n";
+    return ok;
+}
+
+// Loads a binary scene: maps it and copies every array into place, BVHs included.
+template <typename T>
+bool load_scene_binary(const std::string& path, basic_scene<T>& scene) {
+    const int lane_count = simd_packet<T>::width;
+
+    mapped_file mapping;
+    if (!mapping.open(path)) {
+        std::cerr << "Could not open scene file '" << path << "'\n";
+        return false;
+    }
+    scene_binary_reader in(mapping.data(), mapping.size());
+    auto fail = [&](const char* message) {
+        std::cerr << path << ": " << message << "\n";
+        return false;
+    };
+
+    scene_binary_header header;
+    if (!in.raw(&header, sizeof(header)) || memcmp(header.magic, scene_binary_magic, sizeof(scene_binary_magic)) != 0
+        || header.version != scene_binary_version)
+        return fail("not a binary scene of this version");
+    if (header.scalar_size != sizeof(T) || header.lane_count != static_cast<uint32_t>(lane_count))
+        return fail("written for a different precision or SIMD width; compile it again from the text scene");
+
+    scene = basic_scene<T>();
+    std::vector<T> camera_reals;
+    std::vector<int32_t> camera_ints;
+    if (!in.array(camera_reals) || !in.array(camera_ints) || camera_reals.size() != 16 || camera_ints.size() != 5)
+        return fail("truncated camera");
+    auto& cam = scene.cam;
+    cam.aspect_ratio = camera_reals[0];
+    cam.vfov = camera_reals[1];
+    cam.defocus_angle = camera_reals[2];
+    cam.focus_dist = camera_reals[3];
+    cam.lookfrom = basic_point3<T>(camera_reals[4], camera_reals[5], camera_reals[6]);
+    cam.lookat = basic_point3<T>(camera_reals[7], camera_reals[8], camera_reals[9]);
+    cam.vup = basic_vec3<T>(camera_reals[10], camera_reals[11], camera_reals[12]);
+    cam.background = basic_color<T>(camera_reals[13], camera_reals[14], camera_reals[15]);
+    cam.image_width = camera_ints[0];
+    cam.samples_per_pixel = camera_ints[1];
+    cam.max_depth = camera_ints[2];
+    cam.rr_start_depth = camera_ints[3];
+    cam.sky = camera_ints[4] != 0;
+
+    std::vector<uint32_t> material_kinds;
+    std::vector<T> material_values;
+    std::vector<char> material_files;
+    if (!in.array(material_kinds) || !in.array(material_values) || !in.array(material_files)
+        || material_values.size() != material_kinds.size() * 5)
+        return fail("truncated materials");
+    size_t next_file = 0;
+    for (size_t i = 0; i < material_kinds.size(); i++) {
+        if (material_kinds[i] > basic_scene_material<T>::textured)
+            return fail("unknown material kind");
+        basic_scene_material<T> params;
+        const T* values = &material_values[i * 5];
+        params.type = static_cast<typename basic_scene_material<T>::kind>(material_kinds[i]);
+        params.albedo = basic_color<T>(values[0], values[1], values[2]);
+        params.fuzz = values[3];
+        params.ir = values[4];
+        for (std::string* name : { &params.albedo_map, &params.roughness_map, &params.normal_map }) {
+            auto end = std::find(material_files.begin() + next_file, material_files.end(), '\0');
+            if (end == material_files.end())
+                return fail("truncated material textures");
+            name->assign(material_files.begin() + next_file, end);
+            if (!name->empty())
+                *name = scene_relative_path(path, *name);
+            next_file = end - material_files.begin() + 1;
+        }
+
+        basic_material<T> mat = basic_lambertian<T>(params.albedo);
+        if (!params.make(scene.textures, mat))
+            return fail("could not load the textures of a material");
+        scene.materials.add(mat);
+        scene.material_params.push_back(params);
+    }
+    auto material_count = scene.material_params.size();
+
+    typename basic_sphere_bvh<T>::packed_data spheres;
+    if (!in.array(spheres.nodes) || !in.array(spheres.center_x) || !in.array(spheres.center_y) || !in.array(spheres.center_z)
+        || !in.array(spheres.radii) || !in.array(spheres.material_ids))
+        return fail("truncated spheres");
+    auto slot_count = spheres.radii.size();
+    if (spheres.center_x.size() != slot_count || spheres.center_y.size() != slot_count || spheres.center_z.size() != slot_count
+        || spheres.material_ids.size() != slot_count || !valid_scene_bvh(spheres.nodes, slot_count, lane_count))
+        return fail("damaged sphere BVH");
+    for (auto id : spheres.material_ids) {
+        if (id >= material_count)
+            return fail("sphere refers to a missing material");
+    }
+    if (!spheres.nodes.empty())
+        scene.spheres = make_shared<basic_sphere_bvh<T>>(std::move(spheres));
+
+    std::vector<uint64_t> mesh_count;
+    if (!in.array(mesh_count) || mesh_count.size() != 1)
+        return fail("truncated meshes");
+    for (uint64_t m = 0; m < mesh_count[0]; m++) {
+        basic_mesh_data<T> data;
+        std::vector<basic_bvh_flat_node<T>> nodes;
+        std::vector<int> slots;
+        if (!in.array(data.positions) || !in.array(data.normals) || !in.array(data.uvs) || !in.array(data.indices) || !in.array(nodes)
+            || !in.array(slots))
+            return fail("truncated mesh");
+
+        auto triangle_count = static_cast<int>(data.triangle_count());
+        bool ok = data.indices.size() % 3 == 0 && (data.normals.empty() || data.normals.size() == data.positions.size())
+            && (data.uvs.empty() || data.uvs.size() == data.positions.size() * 2)
+            && valid_scene_bvh(nodes, slots.size(), lane_count);
+        for (size_t i = 0; ok && i < data.indices.size(); i++)
+            ok = data.indices[i] < data.positions.size();
+        for (size_t i = 0; ok && i < slots.size(); i++)
+            ok = slots[i] >= -1 && slots[i] < triangle_count;
+        if (!ok)
+            return fail("damaged mesh");
+
+        scene.meshes.push_back(make_shared<basic_triangle_mesh<T>>(std::move(data), 0, std::move(nodes), std::move(slots)));
+    }
+
+    std::vector<uint32_t> instance_ids;
+    std::vector<T> instance_transforms;
+    if (!in.array(instance_ids) || !in.array(instance_transforms) || instance_ids.size() % 2 != 0
+        || instance_transforms.size() != instance_ids.size() / 2 * 12)
+        return fail("truncated instances");
+    for (size_t i = 0; i < instance_ids.size() / 2; i++) {
+        basic_scene_instance<T> inst;
+        inst.mesh = instance_ids[i * 2];
+        inst.mat = instance_ids[i * 2 + 1];
+        if (inst.mesh >= scene.meshes.size() || inst.mat >= material_count)
+            return fail("instance refers to a missing mesh or material");
+        const T* values = &instance_transforms[i * 12];
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++)
+                inst.object_to_world.m[r][c] = values[r * 4 + c];
+            inst.object_to_world.offset[r] = values[r * 4 + 3];
+        }
+        if (inst.object_to_world.determinant() == 0)
+            return fail("instance transform is singular");
+        scene.instances.push_back(inst);
+    }
+
+    std::vector<int32_t> frame_count, camera_key_ids, instance_key_ids;
+    std::vector<T> camera_key_values, step_values;
+    std::vector<uint32_t> step_kinds;
+    if (!in.array(frame_count) || !in.array(camera_key_ids) || !in.array(camera_key_values) || !in.array(instance_key_ids)
+        || !in.array(step_kinds) || !in.array(step_values) || frame_count.size() != 1 || camera_key_ids.size() % 2 != 0
+        || camera_key_values.size() != camera_key_ids.size() / 2 * 3 || instance_key_ids.size() % 3 != 0
+        || step_values.size() != step_kinds.size() * 4)
+        return fail("truncated keys");
+    auto& anim = scene.animation;
+    anim.frame_count = frame_count[0];
+    for (size_t i = 0; i < camera_key_ids.size() / 2; i++) {
+        basic_camera_key<T> key;
+        key.frame = camera_key_ids[i * 2];
+        if (camera_key_ids[i * 2 + 1] < 0 || camera_key_ids[i * 2 + 1] > static_cast<int32_t>(basic_camera_key<T>::focus_dist))
+            return fail("unknown camera key");
+        key.which = static_cast<typename basic_camera_key<T>::setting>(camera_key_ids[i * 2 + 1]);
+        key.value = basic_vec3<T>(camera_key_values[i * 3], camera_key_values[i * 3 + 1], camera_key_values[i * 3 + 2]);
+        anim.camera_keys.push_back(key);
+    }
+    size_t next_step = 0;
+    for (size_t i = 0; i < instance_key_ids.size() / 3; i++) {
+        basic_instance_key<T> key;
+        key.instance = static_cast<uint32_t>(instance_key_ids[i * 3]);
+        key.frame = instance_key_ids[i * 3 + 1];
+        int32_t step_count = instance_key_ids[i * 3 + 2];
+        if (step_count < 0 || static_cast<size_t>(step_count) > step_kinds.size() - next_step)
+            return fail("damaged instance key");
+        for (int32_t s = 0; s < step_count; s++, next_step++) {
+            if (step_kinds[next_step] > basic_transform_step<T>::scale)
+                return fail("unknown transform step");
+            basic_transform_step<T> step;
+            step.type = static_cast<typename basic_transform_step<T>::kind>(step_kinds[next_step]);
+            for (int k = 0; k < 4; k++)
+                step.values[k] = step_values[next_step * 4 + k];
+            key.steps.push_back(step);
+        }
+        anim.instance_keys.push_back(key);
+    }
+    if (next_step != step_kinds.size())
+        return fail("damaged instance key");
+    std::string problem = anim.validate(scene.instances.size());
+    if (!problem.empty())
+        return fail(problem.c_str());
+    return true;
+}
+
+// Loads either form, telling them apart by the binary header.
+template <typename T>
+bool load_scene(const std::string& path, basic_scene<T>& scene) {
+    char magic[8] = {};
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        std::cerr << "Could not open scene file '" << path << "'\n";
+        return false;
+    }
+    size_t read = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    if (read == sizeof(magic) && memcmp(magic, scene_binary_magic, sizeof(magic)) == 0)
+        return load_scene_binary(path, scene);
+    return load_scene_text(path, scene);
+}
+
+using scene_material = basic_scene_material<double>;
+using scene_instance = basic_scene_instance<double>;
+using scene = basic_scene<double>;
+
+#endif
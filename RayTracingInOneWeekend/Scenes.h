@@ -0,0 +1,225 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "rtweekend.h"
+
+#include "BVH.h"
+#include "camera.h"
+#include "color.h"
+#include "HittableList.h"
+#include "material.h"
+#include "sphere.h"
+#include "TriangleMesh.h"
+
+#include <vector>
+
+// The spheres of the final scene from Ray Tracing in One Weekend, without acceleration.
+// Random choices are always drawn in double and then converted, so float and double builds
+// place exactly the same spheres. The scene's materials are appended to `materials`.
+template <typename T>
+basic_hittable_list<T> random_spheres_objects(basic_material_table<T>& materials) {
+    using sphere = basic_sphere<T>;
+    basic_hittable_list<T> world;
+
+    auto ground_material = materials.add(basic_lambertian<T>(basic_color<T>(T(0.5), T(0.5), T(0.5))));
+    world.add(make_shared<sphere>(basic_point3<T>(0, -1000, 0), T(1000), ground_material));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                material_id sphere_material;
+                auto sphere_center = basic_point3<T>(center);
+
+                if (choose_mat < 0.8) {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    sphere_material = materials.add(basic_lambertian<T>(basic_color<T>(albedo)));
+                    world.add(make_shared<sphere>(sphere_center, T(0.2), sphere_material));
+                }
+                else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = materials.add(basic_metal<T>(basic_color<T>(albedo), static_cast<T>(fuzz)));
+                    world.add(make_shared<sphere>(sphere_center, T(0.2), sphere_material));
+                }
+                else {
+                    // glass
+                    sphere_material = materials.add(basic_dielectric<T>(T(1.5)));
+                    world.add(make_shared<sphere>(sphere_center, T(0.2), sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = materials.add(basic_dielectric<T>(T(1.5)));
+    world.add(make_shared<sphere>(basic_point3<T>(0, 1, 0), T(1.0), material1));
+
+    auto material2 = materials.add(basic_lambertian<T>(basic_color<T>(T(0.4), T(0.2), T(0.1))));
+    world.add(make_shared<sphere>(basic_point3<T>(-4, 1, 0), T(1.0), material2));
+
+    auto material3 = materials.add(basic_metal<T>(basic_color<T>(T(0.7), T(0.6), T(0.5)), T(0.0)));
+    world.add(make_shared<sphere>(basic_point3<T>(4, 1, 0), T(1.0), material3));
+
+    return world;
+}
+
+template <typename T>
+basic_hittable_list<T> random_spheres_scene(basic_material_table<T>& materials) {
+    return basic_hittable_list<T>(make_shared<basic_bvh_node<T>>(random_spheres_objects(materials)));
+}
+
+template <typename T>
+void random_spheres_camera(basic_camera<T>& cam) {
+    cam.aspect_ratio = T(16.0 / 9.0);
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 10;
+    cam.max_depth = 10;
+
+    cam.vfov = 20;
+    cam.lookfrom = basic_point3<T>(13, 2, 3);
+    cam.lookat = basic_point3<T>(0, 0, 0);
+    cam.vup = basic_vec3<T>(0, 1, 0);
+
+    cam.defocus_angle = T(0.6);
+    cam.focus_dist = T(10.0);
+}
+
+// A dense grid of small spheres on a ground sphere, `count` x `count` of them, with a random
+// mix of materials.
+template <typename T>
+basic_hittable_list<T> sphere_grid_objects(basic_material_table<T>& materials, int count) {
+    basic_hittable_list<T> world;
+
+    auto ground_material = materials.add(basic_lambertian<T>(basic_color<T>(T(0.5), T(0.5), T(0.5))));
+    world.add(make_shared<basic_sphere<T>>(basic_point3<T>(0, -1000, 0), T(1000), ground_material));
+
+    auto spacing = 0.5;
+    auto start = -0.5 * spacing * (count - 1);
+    for (int a = 0; a < count; a++) {
+        for (int b = 0; b < count; b++) {
+            auto choose_mat = random_double();
+            point3 center(start + a * spacing, 0.2, start + b * spacing);
+
+            material_id sphere_material;
+            if (choose_mat < 0.7)
+                sphere_material = materials.add(basic_lambertian<T>(basic_color<T>(color::random() * color::random())));
+            else if (choose_mat < 0.9)
+                sphere_material = materials.add(basic_metal<T>(basic_color<T>(color::random(0.5, 1)), static_cast<T>(random_double(0, 0.3))));
+            else
+                sphere_material = materials.add(basic_dielectric<T>(T(1.5)));
+            world.add(make_shared<basic_sphere<T>>(basic_point3<T>(center), T(0.2), sphere_material));
+        }
+    }
+
+    return world;
+}
+
+template <typename T>
+void sphere_grid_camera(basic_camera<T>& cam) {
+    cam.aspect_ratio = T(16.0 / 9.0);
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 10;
+    cam.max_depth = 10;
+
+    cam.vfov = 35;
+    cam.lookfrom = basic_point3<T>(0, 8, 24);
+    cam.lookat = basic_point3<T>(0, 0, 0);
+    cam.vup = basic_vec3<T>(0, 1, 0);
+
+    cam.defocus_angle = 0;
+    cam.focus_dist = 10;
+}
+
+// A rolling height field of `resolution` x `resolution` quads (two triangles each) covering a
+// `size` x `size` square centred on the origin, with smooth vertex normals.
+template <typename T>
+basic_mesh_data<T> terrain_mesh(int resolution, double size) {
+    basic_mesh_data<T> mesh;
+    auto height = [](double x, double z) {
+        return 0.3 * std::sin(0.7 * x) * std::cos(0.5 * z) + 0.1 * std::sin(2.3 * x + 1.7 * z);
+    };
+
+    auto step = size / resolution;
+    for (int j = 0; j <= resolution; j++) {
+        for (int i = 0; i <= resolution; i++) {
+            auto x = -0.5 * size + i * step;
+            auto z = -0.5 * size + j * step;
+            auto dx = height(x + 0.5 * step, z) - height(x - 0.5 * step, z);
+            auto dz = height(x, z + 0.5 * step) - height(x, z - 0.5 * step);
+            mesh.positions.push_back(basic_point3<T>(point3(x, height(x, z), z)));
+            mesh.normals.push_back(basic_vec3<T>(unit_vector(vec3(-dx, step, -dz))));
+        }
+    }
+
+    auto row = static_cast<uint32_t>(resolution + 1);
+    for (uint32_t j = 0; j < static_cast<uint32_t>(resolution); j++) {
+        for (uint32_t i = 0; i < static_cast<uint32_t>(resolution); i++) {
+            uint32_t v00 = j * row + i, v10 = v00 + 1, v01 = v00 + row, v11 = v01 + 1;
+            mesh.indices.insert(mesh.indices.end(), { v00, v01, v10, v10, v01, v11 });
+        }
+    }
+    return mesh;
+}
+
+// A UV sphere with `rings` latitude bands and `segments` longitude slices.
+template <typename T>
+basic_mesh_data<T> uv_sphere_mesh(const point3& center, double radius, int rings, int segments) {
+    basic_mesh_data<T> mesh;
+    for (int r = 0; r <= rings; r++) {
+        auto theta = pi * r / rings;
+        for (int s = 0; s <= segments; s++) {
+            auto phi = 2 * pi * s / segments;
+            vec3 n(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            mesh.positions.push_back(basic_point3<T>(center + radius * n));
+            mesh.normals.push_back(basic_vec3<T>(n));
+        }
+    }
+
+    auto row = static_cast<uint32_t>(segments + 1);
+    for (uint32_t r = 0; r < static_cast<uint32_t>(rings); r++) {
+        for (uint32_t s = 0; s < static_cast<uint32_t>(segments); s++) {
+            uint32_t v00 = r * row + s, v10 = v00 + 1, v01 = v00 + row, v11 = v01 + 1;
+            mesh.indices.insert(mesh.indices.end(), { v00, v10, v01, v10, v11, v01 });
+        }
+    }
+    return mesh;
+}
+
+// The meshes of the triangle-heavy scene: a fine height field and three finely tessellated
+// spheres, about 0.5M triangles in total. `materials` receives one material per mesh.
+template <typename T>
+std::vector<basic_mesh_data<T>> triangle_scene_meshes(basic_material_table<T>& materials, std::vector<material_id>& mesh_materials) {
+    std::vector<basic_mesh_data<T>> meshes;
+    meshes.push_back(terrain_mesh<T>(480, 40.0));
+    mesh_materials.push_back(materials.add(basic_lambertian<T>(basic_color<T>(T(0.4), T(0.5), T(0.3)))));
+
+    meshes.push_back(uv_sphere_mesh<T>(point3(-3, 1.2, 0), 1.0, 64, 128));
+    mesh_materials.push_back(materials.add(basic_dielectric<T>(T(1.5))));
+    meshes.push_back(uv_sphere_mesh<T>(point3(0, 1.2, 0), 1.0, 64, 128));
+    mesh_materials.push_back(materials.add(basic_lambertian<T>(basic_color<T>(T(0.7), T(0.3), T(0.2)))));
+    meshes.push_back(uv_sphere_mesh<T>(point3(3, 1.2, 0), 1.0, 64, 128));
+    mesh_materials.push_back(materials.add(basic_metal<T>(basic_color<T>(T(0.7), T(0.6), T(0.5)), T(0.05))));
+    return meshes;
+}
+
+template <typename T>
+void triangle_camera(basic_camera<T>& cam) {
+    cam.aspect_ratio = T(16.0 / 9.0);
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 10;
+    cam.max_depth = 10;
+
+    cam.vfov = 40;
+    cam.lookfrom = basic_point3<T>(0, 3, 9);
+    cam.lookat = basic_point3<T>(0, 1, 0);
+    cam.vup = basic_vec3<T>(0, 1, 0);
+
+    cam.defocus_angle = 0;
+    cam.focus_dist = 10;
+}
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include "rtweekend.h"
+
+#include "BVH.h"
+#include "camera.h"
+#include "Instance.h"
+#include "SceneFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Renders the frames of an animated scene (see basic_animation) back to back in one process.
+// Meshes and their BVHs are loaded once. Between frames the camera moves and keyed instances are
+// placed anew, after which the top-level BVH over the instances is refitted rather than rebuilt.
+// A refit keeps the tree's shape while its boxes stretch to follow the motion, so once its nodes
+// have grown to rebuild_ratio times their built size on average, it is built afresh. All frames
+// share one thread pool and the camera's buffers.
+template <typename T>
+class basic_sequence_renderer {
+public:
+    double rebuild_ratio = 1.5;   // Mean node growth through refits that triggers a rebuild
+    int    first_frame = 0;
+    int    last_frame = -1;       // Last frame to render (-1 = the scene's last)
+
+    int    refits = 0;            // Top-level BVH updates during the last render()
+    int    rebuilds = 0;
+
+    // Writes each frame to `pattern` with its run of '#' replaced by the zero-padded frame
+    // number, e.g. "frame####.png".
+    bool render(const basic_scene<T>& scene, const std::string& pattern) {
+        auto hashes = pattern.find('#');
+        if (hashes == std::string::npos) {
+            std::cerr << "The output pattern '" << pattern << "' needs a run of '#' for the frame number\n";
+            return false;
+        }
+        auto digits = std::min(pattern.find_first_not_of('#', hashes), pattern.size()) - hashes;
+
+        const basic_animation<T>& anim = scene.animation;
+        if (anim.frame_count < 1) {
+            std::cerr << "The scene has no frames to render; give it a 'frames' statement\n";
+            return false;
+        }
+        int last = last_frame < 0 ? anim.frame_count - 1 : std::min(last_frame, anim.frame_count - 1);
+
+        // The world as basic_scene::world() makes it, but holding on to the instances to move them.
+        std::vector<shared_ptr<basic_hittable<T>>> objects;
+        std::vector<shared_ptr<basic_instance<T>>> instances;
+        if (scene.spheres)
+            objects.push_back(scene.spheres);
+        for (const auto& inst : scene.instances) {
+            instances.push_back(make_shared<basic_instance<T>>(scene.meshes[inst.mesh], inst.object_to_world, inst.mat));
+            objects.push_back(instances.back());
+        }
+        if (objects.empty()) {
+            std::cerr << "The scene is empty\n";
+            return false;
+        }
+        auto top = make_shared<basic_bvh_node<T>>(objects);
+
+        basic_camera<T> cam = scene.cam;
+        thread_pool pool(cam.thread_count);
+        refits = 0;
+        rebuilds = 0;
+        auto sequence_start = std::chrono::steady_clock::now();
+
+        for (int frame = first_frame; frame <= last; frame++) {
+            auto frame_start = std::chrono::steady_clock::now();
+            anim.apply_camera(frame, cam);
+
+            bool moved = false;
+            for (size_t i = 0; i < instances.size(); i++) {
+                basic_transform<T> placed;
+                if (anim.instance_transform(static_cast<uint32_t>(i), frame, placed) && !same_transform(placed, instances[i]->transform())) {
+                    instances[i]->set_transform(placed);
+                    moved = true;
+                }
+            }
+
+            const char* update = "unchanged";
+            if (moved) {
+                top->refit();
+                if (top->growth() > rebuild_ratio) {
+                    top = make_shared<basic_bvh_node<T>>(objects);
+                    ++rebuilds;
+                    update = "rebuilt";
+                }
+                else {
+                    ++refits;
+                    update = "refitted";
+                }
+            }
+            std::chrono::duration<double> update_time = std::chrono::steady_clock::now() - frame_start;
+
+            std::string number = std::to_string(frame);
+            if (number.size() < digits)
+                number.insert(0, digits - number.size(), '0');
+            cam.output_path = pattern.substr(0, hashes) + number + pattern.substr(hashes + digits);
+            cam.render(*top, scene.materials, pool);
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - frame_start;
+            std::clog << "Frame " << frame << " -> " << cam.output_path << ": BVH " << update << " in "
+                << update_time.count() * 1000 << " ms, " << elapsed.count() << " s in all\n";
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - sequence_start;
+        std::clog << "Rendered " << last - first_frame + 1 << " frames in " << elapsed.count() << " s ("
+            << refits << " refits, " << rebuilds << " rebuilds)\n";
+        return true;
+    }
+
+private:
+    static bool same_transform(const basic_transform<T>& a, const basic_transform<T>& b) {
+        return memcmp(a.m, b.m, sizeof(a.m)) == 0 && a.offset.x() == b.offset.x() && a.offset.y() == b.offset.y()
+            && a.offset.z() == b.offset.z();
+    }
+};
+
+using sequence_renderer = basic_sequence_renderer<double>;
+
+#endif
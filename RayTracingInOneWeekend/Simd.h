@@ -0,0 +1,172 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Pick the widest packet the compiler is allowed to emit: AVX holds 8 float or 4 double
+// lanes, SSE2 holds 4 float or 2 double lanes.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RT_SIMD_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RT_SIMD_SSE2 1
+#endif
+
+template <typename T, size_t Alignment>
+class aligned_allocator {
+public:
+    using value_type = T;
+
+    template <typename U> struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+    aligned_allocator() = default;
+    template <typename U> aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U> bool operator==(const aligned_allocator<U, Alignment>&) const { return true; }
+    template <typename U> bool operator!=(const aligned_allocator<U, Alignment>&) const { return false; }
+};
+
+template <typename T>
+using aligned_vector = std::vector<T, aligned_allocator<T, 32>>;
+
+// Thin wrappers over one SIMD register of T, so the packet kernel is written once.
+// Masks are full registers; select(mask, a, b) picks a where the mask is set. load() and
+// store() need addresses aligned to the register, loadu() and storeu() do not.
+template <typename T> struct simd_packet;
+
+#if defined(RT_SIMD_AVX)
+template <> struct simd_packet<float> {
+    using reg = __m256;
+    static const int width = 8;
+    static reg set1(float x) { return _mm256_set1_ps(x); }
+    static reg load(const float* p) { return _mm256_load_ps(p); }
+    static void store(float* p, reg a) { _mm256_store_ps(p, a); }
+    static reg loadu(const float* p) { return _mm256_loadu_ps(p); }
+    static void storeu(float* p, reg a) { _mm256_storeu_ps(p, a); }
+    static reg iota() { return _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static reg sqrt(reg a) { return _mm256_sqrt_ps(a); }
+    static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static reg gt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static reg lt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static reg ge(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static reg and_(reg a, reg b) { return _mm256_and_ps(a, b); }
+    static reg or_(reg a, reg b) { return _mm256_or_ps(a, b); }
+    static reg select(reg mask, reg a, reg b) { return _mm256_blendv_ps(b, a, mask); }
+};
+
+template <> struct simd_packet<double> {
+    using reg = __m256d;
+    static const int width = 4;
+    static reg set1(double x) { return _mm256_set1_pd(x); }
+    static reg load(const double* p) { return _mm256_load_pd(p); }
+    static void store(double* p, reg a) { _mm256_store_pd(p, a); }
+    static reg loadu(const double* p) { return _mm256_loadu_pd(p); }
+    static void storeu(double* p, reg a) { _mm256_storeu_pd(p, a); }
+    static reg iota() { return _mm256_set_pd(3, 2, 1, 0); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+    static reg sqrt(reg a) { return _mm256_sqrt_pd(a); }
+    static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+    static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+    static reg gt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static reg lt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static reg ge(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static reg and_(reg a, reg b) { return _mm256_and_pd(a, b); }
+    static reg or_(reg a, reg b) { return _mm256_or_pd(a, b); }
+    static reg select(reg mask, reg a, reg b) { return _mm256_blendv_pd(b, a, mask); }
+};
+#elif defined(RT_SIMD_SSE2)
+template <> struct simd_packet<float> {
+    using reg = __m128;
+    static const int width = 4;
+    static reg set1(float x) { return _mm_set1_ps(x); }
+    static reg load(const float* p) { return _mm_load_ps(p); }
+    static void store(float* p, reg a) { _mm_store_ps(p, a); }
+    static reg loadu(const float* p) { return _mm_loadu_ps(p); }
+    static void storeu(float* p, reg a) { _mm_storeu_ps(p, a); }
+    static reg iota() { return _mm_set_ps(3, 2, 1, 0); }
+    static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+    static reg sqrt(reg a) { return _mm_sqrt_ps(a); }
+    static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+    static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+    static reg gt(reg a, reg b) { return _mm_cmpgt_ps(a, b); }
+    static reg lt(reg a, reg b) { return _mm_cmplt_ps(a, b); }
+    static reg ge(reg a, reg b) { return _mm_cmpge_ps(a, b); }
+    static reg and_(reg a, reg b) { return _mm_and_ps(a, b); }
+    static reg or_(reg a, reg b) { return _mm_or_ps(a, b); }
+    static reg select(reg mask, reg a, reg b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+};
+
+template <> struct simd_packet<double> {
+    using reg = __m128d;
+    static const int width = 2;
+    static reg set1(double x) { return _mm_set1_pd(x); }
+    static reg load(const double* p) { return _mm_load_pd(p); }
+    static void store(double* p, reg a) { _mm_store_pd(p, a); }
+    static reg loadu(const double* p) { return _mm_loadu_pd(p); }
+    static void storeu(double* p, reg a) { _mm_storeu_pd(p, a); }
+    static reg iota() { return _mm_set_pd(1, 0); }
+    static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+    static reg sqrt(reg a) { return _mm_sqrt_pd(a); }
+    static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+    static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+    static reg gt(reg a, reg b) { return _mm_cmpgt_pd(a, b); }
+    static reg lt(reg a, reg b) { return _mm_cmplt_pd(a, b); }
+    static reg ge(reg a, reg b) { return _mm_cmpge_pd(a, b); }
+    static reg and_(reg a, reg b) { return _mm_and_pd(a, b); }
+    static reg or_(reg a, reg b) { return _mm_or_pd(a, b); }
+    static reg select(reg mask, reg a, reg b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+};
+#else
+// Scalar fallback: a "register" is one value and a mask is 0 or 1.
+template <typename T> struct simd_packet {
+    using reg = T;
+    static const int width = 1;
+    static reg set1(T x) { return x; }
+    static reg load(const T* p) { return *p; }
+    static void store(T* p, reg a) { *p = a; }
+    static reg loadu(const T* p) { return *p; }
+    static void storeu(T* p, reg a) { *p = a; }
+    static reg iota() { return 0; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg div(reg a, reg b) { return a / b; }
+    static reg sqrt(reg a) { return std::sqrt(a); }
+    static reg max(reg a, reg b) { return a > b ? a : b; }
+    static reg min(reg a, reg b) { return a < b ? a : b; }
+    static reg gt(reg a, reg b) { return a > b; }
+    static reg lt(reg a, reg b) { return a < b; }
+    static reg ge(reg a, reg b) { return a >= b; }
+    static reg and_(reg a, reg b) { return (a != 0) && (b != 0); }
+    static reg or_(reg a, reg b) { return (a != 0) || (b != 0); }
+    static reg select(reg mask, reg a, reg b) { return mask != 0 ? a : b; }
+};
+#endif
+
+#endif
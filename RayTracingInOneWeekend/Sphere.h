@@ -2,15 +2,21 @@
 #define SPHERE_H
 
 #include "hittable.h"
+#include "Lights.h"
 #include "vec3.h"
 
-class sphere : public hittable {
+template <typename T>
+class basic_sphere : public basic_hittable<T> {
 public:
-    sphere(point3 _center, double _radius, shared_ptr<material> _material)
-        : center(_center), radius(_radius), mat(_material) {}
+    basic_sphere(basic_point3<T> _center, T _radius, material_id _material)
+        : center(_center), radius(_radius), mat(_material)
+    {
+        auto rvec = basic_vec3<T>(radius, radius, radius);
+        bbox = basic_aabb<T>(center - rvec, center + rvec);
+    }
 
-    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-        vec3 oc = r.origin() - center;
+    bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+        basic_vec3<T> oc = r.origin() - center;
         auto a = r.direction().length_squared();
         auto half_b = dot(oc, r.direction());
         auto c = oc.length_squared() - radius * radius;
@@ -29,17 +35,28 @@ public:
 
         rec.t = root;
         rec.p = r.at(rec.t);
-        vec3 outward_normal = (rec.p - center) / radius;
+        basic_vec3<T> outward_normal = (rec.p - center) / radius;
         rec.set_face_normal(r, outward_normal);
+        rec.defer_sphere_uv(radius);
         rec.mat = mat;
+        rec.set_primitive(this, 0);
 
         return true;
     }
 
+    basic_aabb<T> bounding_box() const override { return bbox; }
+
+    void add_lights(basic_light_list<T>& lights) const override {
+        lights.add_sphere(center, radius, mat, this, 0);
+    }
+
 private:
-    point3 center;
-    double radius;
-    shared_ptr<material> mat;
+    basic_point3<T> center;
+    T radius;
+    material_id mat;
+    basic_aabb<T> bbox;
 };
 
-#endif
\ No newline at end of file
+using sphere = basic_sphere<double>;
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "BVH.h"
+#include "hittable.h"
+#include "Simd.h"
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Finds the closest sphere hit among the structure-of-arrays slots [begin, end), a whole number
+// of SIMD packets. `best_t` comes in as the farthest distance of interest and is only lowered by
+// a hit. Same arithmetic as sphere::hit, except that the roots are compared as numerators
+// against t * a (a > 0) and only the winner is divided.
+template <typename T>
+bool closest_sphere_hit(const T* center_x, const T* center_y, const T* center_z, const T* radii, size_t begin, size_t end,
+    const basic_ray<T>& r, T t_min, T& best_t, size_t& best_index)
+{
+    using packet = simd_packet<T>;
+    using reg = typename packet::reg;
+    auto o = r.origin();
+    auto d = r.direction();
+    auto a = d.length_squared();
+
+    const reg ox = packet::set1(o.x()), oy = packet::set1(o.y()), oz = packet::set1(o.z());
+    const reg dx = packet::set1(d.x()), dy = packet::set1(d.y()), dz = packet::set1(d.z());
+    const reg va = packet::set1(a), vmin = packet::set1(t_min * a), zero = packet::set1(0);
+    const reg step = packet::set1(static_cast<T>(packet::width));
+    reg vbest = packet::set1(best_t * a);
+    reg vindex = packet::add(packet::iota(), packet::set1(static_cast<T>(begin)));
+    reg vbest_index = packet::set1(-1);
+
+    for (size_t i = begin; i < end; i += packet::width) {
+        reg ocx = packet::sub(ox, packet::load(&center_x[i]));
+        reg ocy = packet::sub(oy, packet::load(&center_y[i]));
+        reg ocz = packet::sub(oz, packet::load(&center_z[i]));
+        reg rad = packet::load(&radii[i]);
+
+        reg half_b = packet::add(packet::add(packet::mul(ocx, dx), packet::mul(ocy, dy)), packet::mul(ocz, dz));
+        reg oc2 = packet::add(packet::add(packet::mul(ocx, ocx), packet::mul(ocy, ocy)), packet::mul(ocz, ocz));
+        reg c = packet::sub(oc2, packet::mul(rad, rad));
+        reg disc = packet::sub(packet::mul(half_b, half_b), packet::mul(va, c));
+        reg has_root = packet::ge(disc, zero);
+
+        reg sqrtd = packet::sqrt(packet::max(disc, zero));
+        reg neg_b = packet::sub(zero, half_b);
+        reg root0 = packet::sub(neg_b, sqrtd);
+        reg root1 = packet::add(neg_b, sqrtd);
+
+        reg ok0 = packet::and_(packet::gt(root0, vmin), packet::lt(root0, vbest));
+        reg ok1 = packet::and_(packet::gt(root1, vmin), packet::lt(root1, vbest));
+        reg root = packet::select(ok0, root0, root1);
+        reg take = packet::and_(has_root, packet::or_(ok0, ok1));
+
+        vbest = packet::select(take, root, vbest);
+        vbest_index = packet::select(take, vindex, vbest_index);
+        vindex = packet::add(vindex, step);
+    }
+
+    alignas(32) T lane_t[packet::width];
+    alignas(32) T lane_index[packet::width];
+    packet::store(lane_t, vbest);
+    packet::store(lane_index, vbest_index);
+
+    // Nearest hit wins; on a tie the lowest index wins, matching a front-to-back list walk.
+    bool found = false;
+    for (int lane = 0; lane < packet::width; lane++) {
+        if (lane_index[lane] < 0)
+            continue;
+        auto index = static_cast<size_t>(lane_index[lane]);
+        if (!found || lane_t[lane] < best_t || (lane_t[lane] == best_t && index < best_index)) {
+            best_t = lane_t[lane];
+            best_index = index;
+            found = true;
+        }
+    }
+
+    if (found)
+        best_t /= a;
+    return found;
+}
+
+// A structure-of-arrays collection of spheres, intersected several at a time with SIMD.
+template <typename T>
+class basic_sphere_set : public basic_hittable<T> {
+public:
+    using packet = simd_packet<T>;
+    static const int lane_count = packet::width;
+
+    basic_sphere_set() {}
+
+    void add(const basic_point3<T>& center, T radius, material_id mat) {
+        // Overwrite the first padding slot if there is one, otherwise grow by a whole packet.
+        if (count == center_x.size())
+            grow();
+
+        center_x[count] = center.x();
+        center_y[count] = center.y();
+        center_z[count] = center.z();
+        radii[count] = radius;
+        material_ids[count] = mat;
+        count++;
+
+        auto rvec = basic_vec3<T>(radius, radius, radius);
+        bbox = basic_aabb<T>(bbox, basic_aabb<T>(center - rvec, center + rvec));
+    }
+
+    size_t size() const { return count; }
+
+    bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+        if (count == 0)
+            return false;
+
+        T best_t = ray_t.max;
+        size_t best_index = 0;
+        bool found = closest_sphere_hit(center_x.data(), center_y.data(), center_z.data(), radii.data(), 0, center_x.size(),
+            r, ray_t.min, best_t, best_index);
+        if (!found)
+            return false;
+
+        basic_point3<T> center(center_x[best_index], center_y[best_index], center_z[best_index]);
+        rec.t = best_t;
+        rec.p = r.at(rec.t);
+        basic_vec3<T> outward_normal = (rec.p - center) / radii[best_index];
+        rec.set_face_normal(r, outward_normal);
+        rec.defer_sphere_uv(radii[best_index]);
+        rec.mat = material_ids[best_index];
+        rec.set_primitive(this, static_cast<int>(best_index));
+
+        return true;
+    }
+
+    basic_aabb<T> bounding_box() const override { return bbox; }
+
+    void add_lights(basic_light_list<T>& lights) const override {
+        for (size_t i = 0; i < count; i++) {
+            lights.add_sphere(basic_point3<T>(center_x[i], center_y[i], center_z[i]), radii[i], material_ids[i], this,
+                static_cast<int>(i));
+        }
+    }
+
+private:
+    // Padding lanes carry a NaN radius so every comparison against them fails.
+    aligned_vector<T> center_x, center_y, center_z, radii;
+    aligned_vector<material_id> material_ids;
+    size_t count = 0;
+    basic_aabb<T> bbox;
+
+    void grow() {
+        auto nan = std::numeric_limits<T>::quiet_NaN();
+        auto new_size = center_x.size() + lane_count;
+        center_x.resize(new_size, 0);
+        center_y.resize(new_size, 0);
+        center_z.resize(new_size, 0);
+        radii.resize(new_size, nan);
+        material_ids.resize(new_size, 0);
+    }
+};
+
+// One sphere as plain parameters, the way a scene file lists it.
+template <typename T>
+struct basic_sphere_params {
+    basic_point3<T> center;
+    T radius;
+    material_id mat;
+};
+
+// Any number of spheres under one BVH whose leaves are whole SIMD packets, laid out like the
+// triangles of basic_triangle_mesh. A scene's spheres need no heap object each.
+template <typename T>
+class basic_sphere_bvh : public basic_hittable<T> {
+public:
+    using packet = simd_packet<T>;
+    static const int lane_count = packet::width;
+
+    // Everything the BVH keeps, so it can be saved and restored without a rebuild. Leaf offsets
+    // index the slots, which hold the spheres in leaf order; each leaf is padded to whole
+    // packets with NaN radii.
+    struct packed_data {
+        std::vector<basic_bvh_flat_node<T>> nodes;
+        aligned_vector<T> center_x, center_y, center_z, radii;
+        aligned_vector<material_id> material_ids;
+    };
+
+    explicit basic_sphere_bvh(const std::vector<basic_sphere_params<T>>& spheres) {
+        std::vector<basic_aabb<T>> boxes(spheres.size());
+        for (size_t i = 0; i < spheres.size(); i++) {
+            auto rvec = basic_vec3<T>(spheres[i].radius, spheres[i].radius, spheres[i].radius);
+            boxes[i] = basic_aabb<T>(spheres[i].center - rvec, spheres[i].center + rvec);
+        }
+
+        std::vector<int> order;
+        basic_bvh_builder<T>::build(boxes, data.nodes, order, lane_count);
+
+        for (auto& node : data.nodes) {
+            if (node.count == 0)
+                continue;
+
+            auto first_slot = static_cast<int>(data.radii.size());
+            for (int k = 0; k < node.count; k++)
+                append_slot(&spheres[order[node.offset + k]]);
+            while (data.radii.size() % lane_count != 0)
+                append_slot(nullptr);
+            node.offset = first_slot;
+        }
+    }
+
+    explicit basic_sphere_bvh(packed_data packed) : data(std::move(packed)) {}
+
+    const packed_data& packed() const { return data; }
+
+    bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+        if (data.nodes.empty())
+            return false;
+
+        auto dir = r.direction();
+        basic_vec3<T> inv_dir(1 / dir.x(), 1 / dir.y(), 1 / dir.z());
+        bool dir_negative[3] = { dir.x() < 0, dir.y() < 0, dir.z() < 0 };
+
+        bool found = false;
+        size_t best_slot = 0;
+        int stack[bvh_max_depth];
+        int stack_size = 0;
+        int current = 0;
+
+        while (true) {
+            const basic_bvh_flat_node<T>& node = data.nodes[current];
+            if (node.bbox.hit(r, inv_dir, ray_t)) {
+                if (node.count > 0) {
+                    // Lowers ray_t.max on a hit, which culls everything behind it.
+                    size_t slot;
+                    if (closest_sphere_hit(data.center_x.data(), data.center_y.data(), data.center_z.data(), data.radii.data(),
+                        node.offset, node.offset + node.count, r, ray_t.min, ray_t.max, slot)) {
+                        found = true;
+                        best_slot = slot;
+                    }
+                }
+                else {
+                    // Visit the child nearer along the split axis first.
+                    if (dir_negative[node.split_axis]) {
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }
+                    else {
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+                break;
+            current = stack[--stack_size];
+        }
+
+        if (!found)
+            return false;
+
+        basic_point3<T> center(data.center_x[best_slot], data.center_y[best_slot], data.center_z[best_slot]);
+        rec.t = ray_t.max;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, (rec.p - center) / data.radii[best_slot]);
+        rec.defer_sphere_uv(data.radii[best_slot]);
+        rec.mat = data.material_ids[best_slot];
+        rec.set_primitive(this, static_cast<int>(best_slot));
+        return true;
+    }
+
+    basic_aabb<T> bounding_box() const override {
+        return data.nodes.empty() ? basic_aabb<T>() : data.nodes[0].bbox;
+    }
+
+    void add_lights(basic_light_list<T>& lights) const override {
+        for (size_t i = 0; i < data.radii.size(); i++) {
+            if (std::isnan(data.radii[i]))
+                continue; // Padding
+            lights.add_sphere(basic_point3<T>(data.center_x[i], data.center_y[i], data.center_z[i]), data.radii[i],
+                data.material_ids[i], this, static_cast<int>(i));
+        }
+    }
+
+private:
+    packed_data data;
+
+    void append_slot(const basic_sphere_params<T>* sphere) {
+        if (sphere == nullptr) {
+            data.center_x.push_back(0);
+            data.center_y.push_back(0);
+            data.center_z.push_back(0);
+            data.radii.push_back(std::numeric_limits<T>::quiet_NaN());
+            data.material_ids.push_back(0);
+            return;
+        }
+        data.center_x.push_back(sphere->center.x());
+        data.center_y.push_back(sphere->center.y());
+        data.center_z.push_back(sphere->center.z());
+        data.radii.push_back(sphere->radius);
+        data.material_ids.push_back(sphere->mat);
+    }
+};
+
+using sphere_set = basic_sphere_set<double>;
+using sphere_params = basic_sphere_params<double>;
+using sphere_bvh = basic_sphere_bvh<double>;
+
+#endif
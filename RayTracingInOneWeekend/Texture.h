@@ -0,0 +1,177 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "rtweekend.h"
+
+#include "color.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// How the 8-bit texels of an image file turn into values.
+enum class texel_encoding {
+    color,   // Gamma-encoded color such as albedo, decoded with the inverse of linear_to_gamma()
+    linear,  // Data such as roughness: value / 255
+    normal,  // Tangent-space normals: value / 255 * 2 - 1 per channel
+};
+
+// An image with its whole mip chain, each level a 2x2 box filter of the one before, built once at
+// load time. Lookups repeat the image outside [0, 1] and blend bilinearly within the two levels
+// around the requested filter width, so a texture seen from afar or through a wide ray cone shows
+// its average rather than aliasing. v runs up the image, as in OBJ files.
+template <typename T>
+class basic_image_texture {
+public:
+    // Keeps the first `channels` channels (1 or 3) of the file; a single channel is returned in
+    // all three components by sample().
+    bool load(const std::string& path, texel_encoding encoding, int channels) {
+        int width, height, file_channels;
+        stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &file_channels, channels);
+        if (pixels == nullptr) {
+            std::cerr << "Could not load texture '" << path << "': " << stbi_failure_reason() << "\n";
+            return false;
+        }
+
+        float decode[256];
+        for (int i = 0; i < 256; ++i) {
+            float value = i / 255.0f;
+            decode[i] = encoding == texel_encoding::color ? value * value
+                : encoding == texel_encoding::normal ? value * 2 - 1 : value;
+        }
+
+        levels.assign(1, level());
+        levels[0].width = width;
+        levels[0].height = height;
+        levels[0].texels.resize(static_cast<size_t>(width) * height * channels);
+        for (size_t i = 0; i < levels[0].texels.size(); ++i)
+            levels[0].texels[i] = decode[pixels[i]];
+        stbi_image_free(pixels);
+        channel_count = channels;
+
+        // Odd sizes drop their last row or column going down a level.
+        while (levels.back().width > 1 || levels.back().height > 1) {
+            const level& fine = levels.back();
+            level coarse;
+            coarse.width = std::max(fine.width / 2, 1);
+            coarse.height = std::max(fine.height / 2, 1);
+            coarse.texels.resize(static_cast<size_t>(coarse.width) * coarse.height * channels);
+            for (int y = 0; y < coarse.height; ++y) {
+                int y0 = std::min(y * 2, fine.height - 1), y1 = std::min(y * 2 + 1, fine.height - 1);
+                for (int x = 0; x < coarse.width; ++x) {
+                    int x0 = std::min(x * 2, fine.width - 1), x1 = std::min(x * 2 + 1, fine.width - 1);
+                    for (int c = 0; c < channels; ++c) {
+                        coarse.texels[(static_cast<size_t>(y) * coarse.width + x) * channels + c] = 0.25f
+                            * (fine.texel(x0, y0, c, channels) + fine.texel(x1, y0, c, channels)
+                                + fine.texel(x0, y1, c, channels) + fine.texel(x1, y1, c, channels));
+                    }
+                }
+            }
+            levels.push_back(std::move(coarse));
+        }
+        return true;
+    }
+
+    int width() const { return levels.empty() ? 0 : levels[0].width; }
+    int height() const { return levels.empty() ? 0 : levels[0].height; }
+    int level_count() const { return static_cast<int>(levels.size()); }
+
+    // The texture at (u, v), filtered over a square `footprint` texture units wide (1 is the
+    // whole image). Zero gives the full-resolution image, an infinite footprint its average.
+    basic_color<T> sample(T u, T v, T footprint) const {
+        if (levels.empty())
+            return basic_color<T>(0, 0, 0);
+
+        // The level whose texels are as wide as the footprint, between two levels blended.
+        T texels = footprint * std::max(levels[0].width, levels[0].height);
+        T lod = texels > 1 ? std::log2(texels) : 0;
+        lod = std::min(lod, static_cast<T>(levels.size() - 1));
+        if (!(lod >= 0))
+            lod = static_cast<T>(levels.size() - 1);
+        int fine = static_cast<int>(lod);
+        T blend = lod - fine;
+
+        // Repeat the image. Rounding can leave a tiny negative coordinate at exactly 1, and a NaN or
+        // infinite one comes out NaN; either wraps to 0 without disturbing the other coordinate.
+        u -= std::floor(u);
+        v -= std::floor(v);
+        if (!(u >= 0 && u < 1))
+            u = 0;
+        if (!(v >= 0 && v < 1))
+            v = 0;
+
+        basic_color<T> result = bilinear(levels[fine], u, v);
+        if (blend > 0 && fine + 1 < static_cast<int>(levels.size()))
+            result = (1 - blend) * result + blend * bilinear(levels[fine + 1], u, v);
+        return result;
+    }
+
+private:
+    struct level {
+        int width = 0, height = 0;
+        std::vector<float> texels;  // Rows top to bottom, `channels` floats per texel
+
+        float texel(int x, int y, int c, int channels) const {
+            return texels[(static_cast<size_t>(y) * width + x) * channels + c];
+        }
+    };
+
+    std::vector<level> levels;
+    int channel_count = 0;
+
+    basic_color<T> bilinear(const level& l, T u, T v) const {
+        // Texel centers sit at half-integer positions; neighbors wrap around the edges.
+        T x = u * l.width - T(0.5);
+        T y = (1 - v) * l.height - T(0.5);
+        int x0 = static_cast<int>(std::floor(x)), y0 = static_cast<int>(std::floor(y));
+        T fx = x - x0, fy = y - y0;
+        int x1 = x0 + 1 >= l.width ? 0 : x0 + 1, y1 = y0 + 1 >= l.height ? 0 : y0 + 1;
+        if (x0 < 0) x0 = l.width - 1;
+        if (y0 < 0) y0 = l.height - 1;
+
+        T value[3];
+        for (int c = 0; c < channel_count; ++c) {
+            T top = (1 - fx) * l.texel(x0, y0, c, channel_count) + fx * l.texel(x1, y0, c, channel_count);
+            T bottom = (1 - fx) * l.texel(x0, y1, c, channel_count) + fx * l.texel(x1, y1, c, channel_count);
+            value[c] = (1 - fy) * top + fy * bottom;
+        }
+        return channel_count == 1 ? basic_color<T>(value[0], value[0], value[0]) : basic_color<T>(value[0], value[1], value[2]);
+    }
+};
+
+// Textures by file, so every material naming a file shares one copy, loaded and filtered once.
+template <typename T>
+class basic_texture_cache {
+public:
+    // The texture in `path`, loaded on first use; null if the file cannot be read.
+    shared_ptr<const basic_image_texture<T>> get(const std::string& path, texel_encoding encoding) {
+        std::string key = std::to_string(static_cast<int>(encoding)) + ":" + path;
+        auto found = textures.find(key);
+        if (found != textures.end())
+            return found->second;
+
+        auto texture = make_shared<basic_image_texture<T>>();
+        if (!texture->load(path, encoding, encoding == texel_encoding::linear ? 1 : 3))
+            return nullptr;
+        std::clog << "Loaded texture '" << path << "' (" << texture->width() << "x" << texture->height() << ", "
+            << texture->level_count() << " levels)\n";
+        textures.emplace(key, texture);
+        return texture;
+    }
+
+    size_t size() const { return textures.size(); }
+
+private:
+    std::unordered_map<std::string, shared_ptr<const basic_image_texture<T>>> textures;
+};
+
+using image_texture = basic_image_texture<double>;
+using texture_cache = basic_texture_cache<double>;
+
+#endif
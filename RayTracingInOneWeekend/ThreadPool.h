@@ -0,0 +1,122 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+public:
+    // A thread count of 0 uses one worker per hardware thread.
+    explicit thread_pool(int thread_count = 0) {
+        if (thread_count <= 0)
+            thread_count = static_cast<int>(std::thread::hardware_concurrency());
+        if (thread_count <= 0)
+            thread_count = 1;
+
+        for (int i = 0; i < thread_count; ++i)
+            queues.push_back(std::make_unique<work_queue>());
+        for (int i = 0; i < thread_count; ++i)
+            workers.emplace_back([this, i] { worker_loop(i); });
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    void submit(std::function<void()> task) {
+        // Tasks are dealt round-robin; idle workers steal from the others.
+        auto& queue = *queues[next_queue++ % queues.size()];
+        {
+            std::lock_guard<std::mutex> guard(queue.lock);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            ++pending;
+            ++queued;
+        }
+        wake.notify_one();
+    }
+
+    void wait() {
+        // Blocks until every submitted task has finished running.
+        std::unique_lock<std::mutex> guard(sleep_lock);
+        idle.wait(guard, [this] { return pending == 0; });
+    }
+
+private:
+    struct work_queue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<work_queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    int pending = 0;              // Submitted but not yet finished
+    std::atomic<int> queued{ 0 }; // Submitted but not yet picked up
+    bool stopping = false;
+    std::atomic<size_t> next_queue{ 0 };
+
+    bool try_pop(int index, std::function<void()>& task) {
+        // Owners take their newest task, thieves take the oldest one.
+        int count = static_cast<int>(queues.size());
+        for (int k = 0; k < count; ++k) {
+            auto& queue = *queues[(index + k) % count];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (queue.tasks.empty())
+                continue;
+            if (k == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            --queued;
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(int index) {
+        while (true) {
+            std::function<void()> task;
+            if (try_pop(index, task)) {
+                task();
+                std::lock_guard<std::mutex> guard(sleep_lock);
+                if (--pending == 0)
+                    idle.notify_all();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            wake.wait(guard, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0)
+                return;
+        }
+    }
+};
+
+#endif
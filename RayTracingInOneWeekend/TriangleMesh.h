@@ -0,0 +1,323 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "BVH.h"
+#include "hittable.h"
+#include "ObjLoader.h"
+#include "Simd.h"
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// The test depends on an edge shared by two triangles evaluating to exactly opposite values
+// from either side, which fused multiply-adds would break. MSVC only fuses under /fp:fast or
+// /fp:contract; GCC fuses by default, so switch that off for this file.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Per-ray setup of the watertight ray/triangle test (Woop, Benthin and Wald 2013). The ray is
+// sheared so it points down +z from the origin; the three 2D edge functions of a triangle are
+// then evaluated with identical arithmetic for every triangle sharing an edge, so a ray can
+// never slip between two neighbours.
+template <typename T>
+struct basic_watertight_ray {
+    int kx, ky, kz;  // Axis permutation, kz is the dominant direction axis
+    T   sx, sy, sz;  // Shear constants
+
+    explicit basic_watertight_ray(const basic_vec3<T>& dir) {
+        kz = 0;
+        if (fabs(dir[1]) > fabs(dir[kz])) kz = 1;
+        if (fabs(dir[2]) > fabs(dir[kz])) kz = 2;
+        kx = kz == 2 ? 0 : kz + 1;
+        ky = kx == 2 ? 0 : kx + 1;
+
+        // Keep the winding of the sheared triangle independent of the direction's sign.
+        if (dir[kz] < 0)
+            std::swap(kx, ky);
+
+        sx = dir[kx] / dir[kz];
+        sy = dir[ky] / dir[kz];
+        sz = 1 / dir[kz];
+    }
+};
+
+// An indexed triangle mesh with its own BVH. Leaves are stored as whole SIMD packets of
+// triangle vertices, so every triangle of a leaf is tested at once.
+template <typename T>
+class basic_triangle_mesh : public basic_hittable<T> {
+public:
+    using packet = simd_packet<T>;
+    static const int lane_count = packet::width;
+
+    basic_triangle_mesh(const basic_mesh_data<T>& data, material_id m) : mesh(data), mat(m) {
+        auto triangle_count = mesh.triangle_count();
+        std::vector<basic_aabb<T>> boxes(triangle_count);
+        for (size_t i = 0; i < triangle_count; i++) {
+            const auto& a = vertex(i, 0);
+            boxes[i] = basic_aabb<T>(basic_aabb<T>(a, vertex(i, 1)), basic_aabb<T>(a, vertex(i, 2)));
+        }
+
+        std::vector<int> order;
+        basic_bvh_builder<T>::build(boxes, nodes, order, lane_count);
+
+        // Copy each leaf's triangles into consecutive packet slots, padding the last packet
+        // with NaN vertices that fail every comparison. Leaf offsets are rewritten to slots.
+        for (auto& node : nodes) {
+            if (node.count == 0)
+                continue;
+
+            auto first_slot = static_cast<int>(slot_triangle.size());
+            for (int k = 0; k < node.count; k++)
+                append_slot(order[node.offset + k]);
+            while (slot_triangle.size() % lane_count != 0)
+                append_slot(-1);
+            node.offset = first_slot;
+        }
+    }
+
+    // Restores a mesh from the BVH and slot layout of one built earlier (see bvh_nodes() and
+    // slots()), skipping the build; only the packet coordinates are gathered again.
+    basic_triangle_mesh(basic_mesh_data<T> data, material_id m, std::vector<basic_bvh_flat_node<T>> bvh_nodes,
+        std::vector<int> slots) : mesh(std::move(data)), mat(m), nodes(std::move(bvh_nodes))
+    {
+        for (auto& corner : coords) {
+            for (auto& axis : corner)
+                axis.reserve(slots.size());
+        }
+        slot_triangle.reserve(slots.size());
+        for (int triangle : slots)
+            append_slot(triangle);
+    }
+
+    size_t triangle_count() const { return mesh.triangle_count(); }
+
+    const basic_mesh_data<T>& mesh_data() const { return mesh; }
+    const std::vector<basic_bvh_flat_node<T>>& bvh_nodes() const { return nodes; }
+    const std::vector<int>& slots() const { return slot_triangle; }
+
+    bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+        if (nodes.empty())
+            return false;
+
+        auto dir = r.direction();
+        basic_vec3<T> inv_dir(1 / dir.x(), 1 / dir.y(), 1 / dir.z());
+        bool dir_negative[3] = { dir.x() < 0, dir.y() < 0, dir.z() < 0 };
+        basic_watertight_ray<T> shear(dir);
+
+        int best_slot = -1;
+        int stack[bvh_max_depth];
+        int stack_size = 0;
+        int current = 0;
+
+        while (true) {
+            const basic_bvh_flat_node<T>& node = nodes[current];
+            if (node.bbox.hit(r, inv_dir, ray_t)) {
+                if (node.count > 0) {
+                    // Shrinks ray_t.max on a hit, which culls everything behind it.
+                    hit_leaf(r, shear, node, ray_t.min, ray_t.max, best_slot);
+                }
+                else {
+                    // Visit the child nearer along the split axis first.
+                    if (dir_negative[node.split_axis]) {
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }
+                    else {
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+                break;
+            current = stack[--stack_size];
+        }
+
+        if (best_slot < 0)
+            return false;
+
+        fill_record(r, shear, slot_triangle[best_slot], ray_t.max, rec);
+        return true;
+    }
+
+    basic_aabb<T> bounding_box() const override {
+        return nodes.empty() ? basic_aabb<T>() : nodes[0].bbox;
+    }
+
+    void add_lights(basic_light_list<T>& lights) const override {
+        if (!lights.emits(mat))
+            return;
+        for (size_t triangle = 0; triangle < mesh.triangle_count(); triangle++) {
+            lights.add_triangle(vertex(triangle, 0), vertex(triangle, 1), vertex(triangle, 2), mat, this,
+                static_cast<int>(triangle));
+        }
+    }
+
+private:
+    basic_mesh_data<T> mesh;
+    material_id mat;
+    std::vector<basic_bvh_flat_node<T>> nodes;
+
+    // Packet slots in leaf order: coords[vertex][axis][slot]. Padding slots map to triangle -1.
+    aligned_vector<T> coords[3][3];
+    std::vector<int> slot_triangle;
+
+    const basic_point3<T>& vertex(size_t triangle, int corner) const {
+        return mesh.positions[mesh.indices[triangle * 3 + corner]];
+    }
+
+    void append_slot(int triangle) {
+        auto nan = std::numeric_limits<T>::quiet_NaN();
+        for (int corner = 0; corner < 3; corner++) {
+            for (int axis = 0; axis < 3; axis++)
+                coords[corner][axis].push_back(triangle < 0 ? nan : vertex(triangle, corner)[axis]);
+        }
+        slot_triangle.push_back(triangle);
+    }
+
+    void hit_leaf(const basic_ray<T>& r, const basic_watertight_ray<T>& shear, const basic_bvh_flat_node<T>& node,
+        T t_min, T& best_t, int& best_slot) const
+    {
+        using reg = typename packet::reg;
+        auto o = r.origin();
+        const reg zero = packet::set1(0);
+        const reg sx = packet::set1(shear.sx), sy = packet::set1(shear.sy), sz = packet::set1(shear.sz);
+        const reg ox = packet::set1(o[shear.kx]), oy = packet::set1(o[shear.ky]), oz = packet::set1(o[shear.kz]);
+        const reg vmin = packet::set1(t_min);
+        const reg step = packet::set1(static_cast<T>(lane_count));
+        reg vbest = packet::set1(best_t);
+        reg vslot = packet::add(packet::iota(), packet::set1(static_cast<T>(node.offset)));
+        reg vbest_slot = packet::set1(-1);
+
+        int end = node.offset + node.count;
+        for (int i = node.offset; i < end; i += lane_count) {
+            // Triangle corners relative to the origin, in the permuted frame.
+            reg e[3][3];
+            for (int corner = 0; corner < 3; corner++) {
+                reg az = packet::sub(packet::load(&coords[corner][shear.kz][i]), oz);
+                e[corner][0] = packet::sub(packet::sub(packet::load(&coords[corner][shear.kx][i]), ox), packet::mul(sx, az));
+                e[corner][1] = packet::sub(packet::sub(packet::load(&coords[corner][shear.ky][i]), oy), packet::mul(sy, az));
+                e[corner][2] = packet::mul(sz, az);
+            }
+
+            // Scaled barycentrics; the ray passes inside when all three share a sign.
+            reg u = packet::sub(packet::mul(e[2][0], e[1][1]), packet::mul(e[2][1], e[1][0]));
+            reg v = packet::sub(packet::mul(e[0][0], e[2][1]), packet::mul(e[0][1], e[2][0]));
+            reg w = packet::sub(packet::mul(e[1][0], e[0][1]), packet::mul(e[1][1], e[0][0]));
+            reg all_positive = packet::and_(packet::and_(packet::ge(u, zero), packet::ge(v, zero)), packet::ge(w, zero));
+            reg all_negative = packet::and_(packet::and_(packet::ge(zero, u), packet::ge(zero, v)), packet::ge(zero, w));
+            reg inside = packet::or_(all_positive, all_negative);
+
+            // A zero determinant gives an infinite or NaN t, which fails the range test below.
+            reg det = packet::add(packet::add(u, v), w);
+            reg scaled_t = packet::add(packet::add(packet::mul(u, e[0][2]), packet::mul(v, e[1][2])), packet::mul(w, e[2][2]));
+            reg t = packet::div(scaled_t, det);
+            reg take = packet::and_(inside, packet::and_(packet::gt(t, vmin), packet::lt(t, vbest)));
+
+            vbest = packet::select(take, t, vbest);
+            vbest_slot = packet::select(take, vslot, vbest_slot);
+            vslot = packet::add(vslot, step);
+        }
+
+        alignas(32) T lane_t[lane_count];
+        alignas(32) T lane_slot[lane_count];
+        packet::store(lane_t, vbest);
+        packet::store(lane_slot, vbest_slot);
+
+        // Nearest hit wins; on a tie the lowest slot wins, so results do not depend on the width.
+        bool found = false;
+        for (int lane = 0; lane < lane_count; lane++) {
+            if (lane_slot[lane] < 0)
+                continue;
+            auto slot = static_cast<int>(lane_slot[lane]);
+            if (!found || lane_t[lane] < best_t || (lane_t[lane] == best_t && slot < best_slot)) {
+                best_t = lane_t[lane];
+                best_slot = slot;
+                found = true;
+            }
+        }
+    }
+
+    void fill_record(const basic_ray<T>& r, const basic_watertight_ray<T>& shear, int triangle, T t, basic_hit_record<T>& rec) const {
+        const auto& a = vertex(triangle, 0);
+        const auto& b = vertex(triangle, 1);
+        const auto& c = vertex(triangle, 2);
+
+        rec.t = t;
+        rec.p = r.at(t);
+        rec.set_face_normal(r, unit_vector(cross(b - a, c - a)));
+        rec.mat = mat;
+        rec.set_primitive(this, triangle);
+        rec.u = rec.v = 0;
+        rec.dpdu = rec.dpdv = basic_vec3<T>(0, 0, 0);
+        rec.pending_radius = 0;
+
+        if (mesh.normals.empty() && mesh.uvs.empty())
+            return;
+
+        // Interpolate the vertex attributes with the same barycentrics the intersection test used.
+        auto o = r.origin();
+        auto project = [&](const basic_point3<T>& p, T& x, T& y) {
+            auto az = p[shear.kz] - o[shear.kz];
+            x = (p[shear.kx] - o[shear.kx]) - shear.sx * az;
+            y = (p[shear.ky] - o[shear.ky]) - shear.sy * az;
+        };
+        T ax, ay, bx, by, cx, cy;
+        project(a, ax, ay);
+        project(b, bx, by);
+        project(c, cx, cy);
+        T u = cx * by - cy * bx;
+        T v = ax * cy - ay * cx;
+        T w = bx * ay - by * ax;
+
+        const auto* index = &mesh.indices[static_cast<size_t>(triangle) * 3];
+
+        if (!mesh.uvs.empty()) {
+            // The barycentrics are scaled by the determinant, which cancels in the normal below
+            // but not here.
+            T scale = 1 / (u + v + w);
+            const T* uv0 = &mesh.uvs[index[0] * 2];
+            const T* uv1 = &mesh.uvs[index[1] * 2];
+            const T* uv2 = &mesh.uvs[index[2] * 2];
+            rec.u = (u * uv0[0] + v * uv1[0] + w * uv2[0]) * scale;
+            rec.v = (u * uv0[1] + v * uv1[1] + w * uv2[1]) * scale;
+
+            // The edges as combinations of the texture axes give the derivatives, which stay
+            // zero for a triangle whose coordinates are degenerate.
+            T du1 = uv1[0] - uv0[0], dv1 = uv1[1] - uv0[1];
+            T du2 = uv2[0] - uv0[0], dv2 = uv2[1] - uv0[1];
+            T det = du1 * dv2 - dv1 * du2;
+            if (det != 0) {
+                rec.dpdu = (dv2 * (b - a) - dv1 * (c - a)) / det;
+                rec.dpdv = (du1 * (c - a) - du2 * (b - a)) / det;
+            }
+        }
+
+        if (mesh.normals.empty())
+            return;
+
+        // Smooth shading: face the interpolated normal the same way as the geometric normal.
+        auto shading = unit_vector(u * mesh.normals[index[0]] + v * mesh.normals[index[1]] + w * mesh.normals[index[2]]);
+        if (dot(shading, rec.normal) < 0)
+            shading = -shading;
+        rec.normal = shading;
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+using watertight_ray = basic_watertight_ray<double>;
+using triangle_mesh = basic_triangle_mesh<double>;
+
+#endif